@@ -1,39 +1,33 @@
 #pragma once
 
 #include <src/core/bus.h>
+#include <src/core/cpu/arm_core.h>
 
 namespace ARM7
 {
 
+// How the shared core reaches the ARM7 side of the system
+struct BusInterface
+{
+	static uint32_t Read32(uint32_t addr) { return Bus::Read32_ARM7(addr); }
+	static uint16_t Read16(uint32_t addr) { return Bus::Read16_ARM7(addr); }
+	static uint8_t Read8(uint32_t addr) { return Bus::Read8_ARM7(addr); }
+
+	static void Write32(uint32_t addr, uint32_t data) { Bus::Write32_ARM7(addr, data); InvalidateCodeCaches(false, addr); }
+	static void Write16(uint32_t addr, uint16_t data) { Bus::Write16_ARM7(addr, data); InvalidateCodeCaches(false, addr); }
+	static void Write8(uint32_t addr, uint8_t data) { Bus::Write8_ARM7(addr, data); InvalidateCodeCaches(false, addr); }
+
+	static bool IsInterruptAvailable() { return Bus::IsInterruptAvailable7(); }
+	static bool IsInterruptPending() { return Bus::IsInterruptPending7(); }
+	static uint32_t ExceptionBase() { return 0x00000000; }
+};
+
+using Core = ARMCore<ARMVersion::ARMv4T, BusInterface>;
+
 void Reset();
-void Clock();
+void Run(int cycles);
 void Dump();
+
 void DirectBoot(uint32_t entry);
 
-bool IsBranchExchange(uint32_t i);
-bool IsBlockDataTransfer(uint32_t i);
-bool IsBranch(uint32_t i);
-bool IsSingleDataTransfer(uint32_t i);
-bool IsDataProcessing(uint32_t i);
-bool IsPSRTransferMSR(uint32_t opcode);
-bool IsPSRTransferMRS(uint32_t opcode);
-
-bool IsMovCmpSubAdd(uint16_t i);
-bool IsPCRelativeLoad(uint16_t i);
-bool IsLoadStoreRegister(uint16_t i);
-bool IsConditionalBranch(uint16_t i);
-bool IsHighOp(uint16_t i);
-bool IsPushPop(uint16_t i);
-bool IsHalfwordTransfer(uint16_t i);
-bool IsBranchLongWithLink(uint16_t i);
-bool IsMoveShifted(uint16_t i);
-bool IsALUOperation(uint16_t i);
-bool LoadStoreImm(uint16_t i);
-bool IsSPRelativeLoadStore(uint16_t i);
-bool IsAddOffsetToStackPointer(uint16_t i);
-bool IsUnconditionalBranch(uint16_t i);
-bool IsAddSubtract(uint16_t i);
-bool IsLoadAddress(uint16_t i);
-bool IsLoadStoreMultiple(uint16_t i);
-bool IsLoadStoreHWSignExtend(uint16_t i);
-}
\ No newline at end of file
+}
@@ -1,80 +1,37 @@
 #pragma once
 
 #include <src/core/bus.h>
+#include <src/core/arm9/cp15.h>
+#include <src/core/cpu/arm_core.h>
 
 namespace ARM9
 {
 
-
-union PSR
+// How the shared core reaches the ARM9 side of the system
+struct BusInterface
 {
-    uint32_t val;
-    struct
-    {
-        uint32_t mode : 5;
-        uint32_t t : 1;
-        uint32_t f : 1;
-        uint32_t i : 1;
-        uint32_t a : 1;
-        uint32_t e : 1;
-        uint32_t : 14;
-        uint32_t j : 1;
-        uint32_t : 2;
-        uint32_t q : 1;
-        uint32_t v : 1;
-        uint32_t c : 1;
-        uint32_t z : 1;
-        uint32_t n : 1;
-    } flags;
-};
+	static uint32_t Read32(uint32_t addr) { return Bus::Read32(addr); }
+	static uint16_t Read16(uint32_t addr) { return Bus::Read16(addr); }
+	static uint8_t Read8(uint32_t addr) { return Bus::Read8(addr); }
 
-void Reset();
-void Clock();
-void Dump();
+	static void Write32(uint32_t addr, uint32_t data) { Bus::Write32(addr, data); InvalidateCodeCaches(true, addr); }
+	static void Write16(uint32_t addr, uint16_t data) { Bus::Write16(addr, data); InvalidateCodeCaches(true, addr); }
+	static void Write8(uint32_t addr, uint8_t data) { Bus::Write8(addr, data); InvalidateCodeCaches(true, addr); }
 
-bool IsMulMula(uint32_t i);
-bool IsMullMlal(uint32_t i);
-bool IsBranchExchange2(uint32_t i);
-bool IsBranchLinkExchange(uint32_t i);
-bool IsBranchExchange(uint32_t i);
-bool IsBlockDataTransfer(uint32_t i);
-bool IsBranchAndLink(uint32_t i);
-bool IsSingleDataTransfer(uint32_t i);
-bool IsPSRTransferMSR(uint32_t opcode);
-bool IsHalfwordTransfer(uint32_t i);
-bool IsHalfwordTransfer2(uint32_t i);
-bool IsHalfwordTransferRegister(uint32_t i);
-bool IsDataProcessing(uint32_t i);
-bool IsCPTransfer(uint32_t i);
+	static bool IsInterruptAvailable() { return Bus::IsInterruptAvailable9(); }
+	static bool IsInterruptPending() { return Bus::IsInterruptPending9(); }
+	static uint32_t ExceptionBase() { return CP15::GetExceptionBase(); }
 
-bool IsArithmeticThumb(uint16_t i);
-bool IsConditionalBranch(uint16_t i);
-bool IsBranchExchangeThumb(uint16_t i);
-bool IsLDR_PCRel(uint16_t i);
-bool IsSTR_Reg(uint16_t i);
-bool IsPushPop(uint16_t i);
-bool IsSTRH_Imm(uint16_t i);
-bool IsBranchLink(uint16_t i);
-bool IsLoadHalfwordImmediate(uint16_t i);
-bool IsLSL1(uint16_t i);
-bool IsLSR1(uint16_t i);
-bool IsCMP2(uint16_t i);
-bool IsLDR_Imm(uint16_t i);
-bool IsALUThumb(uint16_t i);
-bool IsSPRelativeLoadStore(uint16_t i);
-bool IsHiRegisterOperation(uint16_t i);
+	static uint32_t ReadCP15(uint32_t cn, uint32_t cm, uint32_t cp) { return CP15::ReadCP15(cn, cm, cp); }
+	static void WriteCP15(uint32_t cn, uint32_t cm, uint32_t cp, uint32_t data) { CP15::WriteCP15(cn, cm, cp, data); }
+};
 
-bool CondPassed(uint8_t cond);
+using Core = ARMCore<ARMVersion::ARMv5TE, BusInterface>;
 
-void ThumbPush(uint16_t i);
-void ThumbPop(uint16_t i);
+void Reset();
+void Run(int cycles);
+void Dump();
 
 void DirectBoot(uint32_t entry);
 
-template<class T>
-T ror(T x, unsigned int moves)
-{
-    return (x >> moves) | (x << sizeof(T)*__CHAR_BIT__ - moves);
 }
-
-}
\ No newline at end of file
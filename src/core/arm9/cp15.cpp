@@ -1,5 +1,6 @@
 #include "cp15.h"
 #include <src/core/arm9/arm9.h>
+#include <src/core/log.h>
 
 #include <cstdio>
 #include <cstdlib>
@@ -19,19 +20,32 @@ void WriteCP15(uint32_t cn, uint32_t cm, uint32_t cp, uint32_t data)
 		control = data;
 		return;
 	}
-	else if (cn == 7 && cm == 5 && cp == 0)
+	else if ((cn == 7 && cm == 0 && cp == 4) || (cn == 7 && cm == 8 && cp == 2))
 	{
-		printf("Invalidate icache\n");
+		LOG_DEBUG(CP15, "Wait for interrupt\n");
+		ARM9::Core::Halt();
+		return;
+	}
+	else if (cn == 7 && cm == 5 && (cp == 0 || cp == 2))
+	{
+		LOG_DEBUG(CP15, "Invalidate icache\n");
+		ARM9::Core::InvalidateAllCode();
+		return;
+	}
+	else if (cn == 7 && cm == 5 && cp == 1)
+	{
+		LOG_DEBUG(CP15, "Invalidate icache line 0x%08x\n", data);
+		ARM9::Core::InvalidateCode(data);
 		return;
 	}
 	else if (cn == 7 && cm == 6 && cp == 0)
 	{
-		printf("Invalidate dcache\n");
+		LOG_DEBUG(CP15, "Invalidate dcache\n");
 		return;
 	}
 	else if (cn == 7 && cm == 10 && cp == 4)
 	{
-		printf("Drain write buffer\n");
+		LOG_DEBUG(CP15, "Drain write buffer\n");
 		return;
 	}
 	else if (cn == 9 && cm == 1 && cp == 0)
@@ -41,13 +55,13 @@ void WriteCP15(uint32_t cn, uint32_t cm, uint32_t cp, uint32_t data)
 
 		dtcm = data;
 
-		printf("Remapping Data TCM to 0x%08x\n", dtcm_base);
+		LOG_INFO(CP15, "Remapping Data TCM to 0x%08x\n", dtcm_base);
 
 		Bus::RemapDTCM(dtcm_base);
 		return;
 	}
 
-	printf("Write to unknown cp15 register 0,C%d,C%d,%d\n", cn, cm, cp);
+	LOG_ERROR(CP15, "Write to unknown cp15 register 0,C%d,C%d,%d\n", cn, cm, cp);
 	ARM9::Dump();
 	exit(1);
 }
@@ -103,9 +117,14 @@ uint32_t ReadCP15(uint32_t cn, uint32_t cm, uint32_t cp)
 		return 0;
 	}
 
-	printf("Read from unknown cp15 register 0,C%d,C%d,%d\n", cn, cm, cp);
+	LOG_ERROR(CP15, "Read from unknown cp15 register 0,C%d,C%d,%d\n", cn, cm, cp);
 	ARM9::Dump();
 	exit(1);
 }
 
+uint32_t GetExceptionBase()
+{
+	return exception_vectors;
+}
+
 }
\ No newline at end of file
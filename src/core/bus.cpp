@@ -2,12 +2,21 @@
 
 #include <src/core/arm9/arm9.h>
 #include <src/core/arm7/arm7.h>
+#include <src/core/dma/dma.h>
 #include <src/core/gpu/gpu.h>
 #include <src/core/spi/rtc.h>
 #include <src/core/spi/cart.h>
 #include <src/core/spi/firmware.h>
+#include <src/core/timers/timers.h>
+#include <src/core/mmio.h>
+#include <src/core/log.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 uint8_t* arm9_bios; // The ARM9 and ARM7 have different BIOSes on different chips, so we keep them in seperate arrays
 uint8_t* arm7_bios;
@@ -25,31 +34,252 @@ uint32_t ie_arm9, if_arm9;
 bool postflg_arm9 = false; // POSTFLG is used for making sure that games following a stray pointer don't execute BIOS code
 bool postflg_arm7 = false;
 
-uint8_t dtcm[0x4000]; // Data Tightly-Coupled memory, ARM9 only, remappable
-uint8_t* arm9_ram; // ARM9's main RAM, PSRAM, 4MB
+uint8_t* dtcm; // Data Tightly-Coupled memory, ARM9 only, remappable
+uint8_t* main_ram; // Main RAM, PSRAM, 4MB, shared by both CPUs
 
 uint16_t arm9_ipcsync; // Used for synchronization primitives between ARM9 and ARM7
 uint16_t arm7_ipcsync;
 
-uint8_t* arm7_wram; // 16-KiB of ARM7-exclusive WRAM
+uint8_t* arm7_wram; // 64-KiB of ARM7-exclusive WRAM
 uint8_t* shared_wram; // Shared WRAM; Each processor can have one 16KiB bank, or one processor gets all 32KiB
 
-uint8_t* arm7_ram; // Same as ARM9's RAM, but for ARM7
-
 int wramcnt = 0;
 
 bool mem_initialized = false;
 
 uint16_t keyinput = 0x3FF;
 
+// All RAM lives in one memfd. Each CPU reserves a 4 GiB host region and maps views of it at the
+// guest addresses, mirrors included, so a RAM access is a plain host access at base + addr.
+// Everything else is left unmapped and page_flags sends it to the I/O handlers below
+constexpr size_t main_ram_offset = 0;
+constexpr size_t shared_wram_offset = main_ram_offset + 4*1024*1024;
+constexpr size_t arm7_wram_offset = shared_wram_offset + 0x8000;
+constexpr size_t dtcm_offset = arm7_wram_offset + 0x10000;
+constexpr size_t arm9_bios_offset = dtcm_offset + 0x4000;
+constexpr size_t arm7_bios_offset = arm9_bios_offset + 0x10000;
+constexpr size_t mem_size = arm7_bios_offset + 0x4000;
+
+// The guest can only address 4 GiB, the extra page catches accesses straddling the top
+constexpr size_t arena_size = (1ull << 32) + 0x4000;
+
+constexpr int page_shift = 14;
+constexpr uint32_t page_count = 1 << (32 - page_shift);
+
+enum PageFlags : uint8_t
+{
+	PAGE_READ = 1,
+	PAGE_WRITE = 2,
+};
+
+int mem_fd = -1;
+uint8_t* fastmem9;
+uint8_t* fastmem7;
+
+uint8_t page_flags9[page_count];
+uint8_t page_flags7[page_count];
+
+uint8_t* MapArena(size_t size)
+{
+	void* ptr = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (ptr == MAP_FAILED)
+	{
+		LOG_ERROR(Bus, "Couldn't reserve guest address space\n");
+		exit(1);
+	}
+	return (uint8_t*)ptr;
+}
+
+// Maps [start, end) of a guest address space onto the memfd, mirroring the view if the range is larger
+void MapView(uint8_t* base, uint8_t* flags, uint64_t start, uint64_t end, size_t offset, size_t size, uint8_t access)
+{
+	int prot = PROT_READ | ((access & PAGE_WRITE) ? PROT_WRITE : 0);
+
+	for (uint64_t addr = start; addr < end; addr += size)
+	{
+		if (mmap(base + addr, size, prot, MAP_SHARED | MAP_FIXED, mem_fd, offset) == MAP_FAILED)
+		{
+			LOG_ERROR(Bus, "Couldn't map guest memory at 0x%08lx\n", addr);
+			exit(1);
+		}
+	}
+
+	std::fill(&flags[start >> page_shift], &flags[end >> page_shift], access);
+}
+
+void ClearArena(uint8_t* base, uint8_t* flags)
+{
+	mmap(base, arena_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+	std::fill_n(flags, page_count, 0);
+}
+
+// Rebuilt whenever the memory layout changes (WRAMCNT, DTCM remapping)
+void UpdatePageTables()
+{
+	constexpr uint8_t rw = PAGE_READ | PAGE_WRITE;
+
+	ClearArena(fastmem9, page_flags9);
+	ClearArena(fastmem7, page_flags7);
+
+	MapView(fastmem9, page_flags9, 0x02000000, 0x03000000, main_ram_offset, 4*1024*1024, rw);
+	MapView(fastmem7, page_flags7, 0x02000000, 0x03000000, main_ram_offset, 4*1024*1024, rw);
+
+	// Shared WRAM is split between the CPUs, the ARM7 sees its own WRAM if it gets nothing
+	switch (wramcnt)
+	{
+	case 0:
+		MapView(fastmem9, page_flags9, 0x03000000, 0x04000000, shared_wram_offset, 0x8000, rw);
+		MapView(fastmem7, page_flags7, 0x03000000, 0x03800000, arm7_wram_offset, 0x10000, rw);
+		break;
+	case 1:
+		MapView(fastmem9, page_flags9, 0x03000000, 0x04000000, shared_wram_offset + 0x4000, 0x4000, rw);
+		MapView(fastmem7, page_flags7, 0x03000000, 0x03800000, shared_wram_offset, 0x4000, rw);
+		break;
+	case 2:
+		MapView(fastmem9, page_flags9, 0x03000000, 0x04000000, shared_wram_offset, 0x4000, rw);
+		MapView(fastmem7, page_flags7, 0x03000000, 0x03800000, shared_wram_offset + 0x4000, 0x4000, rw);
+		break;
+	case 3:
+		MapView(fastmem7, page_flags7, 0x03000000, 0x03800000, shared_wram_offset, 0x8000, rw);
+		break;
+	}
+
+	MapView(fastmem7, page_flags7, 0x03800000, 0x04000000, arm7_wram_offset, 0x10000, rw);
+
+	// BIOS writes are ignored or fatal, so they stay on the slow path
+	MapView(fastmem9, page_flags9, 0xFFFF0000, 0x100000000, arm9_bios_offset, 0x10000, PAGE_READ);
+	MapView(fastmem7, page_flags7, 0, 0x4000, arm7_bios_offset, 0x4000, PAGE_READ);
+
+	// DTCM goes last since it takes priority over whatever it's mapped on top of
+	MapView(fastmem9, page_flags9, dtcm_start, dtcm_start + 0x4000ull, dtcm_offset, 0x4000, rw);
+}
+
+void WriteIPCSYNC(uint16_t& local, uint16_t& remote, uint16_t data)
+{
+	remote &= 0xFFF0;
+	remote |= ((data & 0x0F00) >> 8);
+	local &= 0xB0FF;
+	local |= (data & 0x4F00);
+	if ((data & 0x2000) && (remote & 0x4000))
+	{
+		LOG_ERROR(IPC, "IPCSYNC IRQs are not implemented\n");
+		exit(1);
+	}
+}
+
+void RegisterMMIO()
+{
+	MMIO::Register(MMIO::CPU9, 0x04000180, 2, []() -> uint32_t { return arm9_ipcsync; }, [](uint32_t data, uint32_t mask)
+	{
+		data = MMIO::Merge(arm9_ipcsync, data, mask);
+		LOG_DEBUG(IPC, "Sending value 0x%x to ARM7\n", (data & 0x0F00) >> 8);
+		WriteIPCSYNC(arm9_ipcsync, arm7_ipcsync, data);
+	});
+	MMIO::Register(MMIO::CPU7, 0x04000180, 2, []() -> uint32_t { return arm7_ipcsync; },
+		[](uint32_t data, uint32_t mask) { WriteIPCSYNC(arm7_ipcsync, arm9_ipcsync, MMIO::Merge(arm7_ipcsync, data, mask)); });
+
+	MMIO::Register(MMIO::CPU9, 0x04000208, 4, []() -> uint32_t { return ime_arm9; },
+		[](uint32_t data, uint32_t mask) { if (mask & 1) ime_arm9 = data & 1; });
+	MMIO::Register(MMIO::CPU7, 0x04000208, 4, []() -> uint32_t { return ime_arm7; },
+		[](uint32_t data, uint32_t mask) { if (mask & 1) ime_arm7 = data & 1; });
+
+	MMIO::Register(MMIO::CPU9, 0x04000210, 4, []() -> uint32_t { return ie_arm9; },
+		[](uint32_t data, uint32_t mask) { ie_arm9 = MMIO::Merge(ie_arm9, data, mask); });
+	MMIO::Register(MMIO::CPU7, 0x04000210, 4, []() -> uint32_t { return ie_arm7; }, [](uint32_t data, uint32_t mask)
+	{
+		ie_arm7 = MMIO::Merge(ie_arm7, data, mask);
+		LOG_DEBUG(IRQ, "Writing 0x%08x to ARM7's IE\n", ie_arm7);
+	});
+
+	// Writing a 1 to an IF bit acknowledges that interrupt
+	MMIO::Register(MMIO::CPU9, 0x04000214, 4, []() -> uint32_t { return if_arm9; },
+		[](uint32_t data, uint32_t mask) { if_arm9 &= ~(data & mask); });
+	MMIO::Register(MMIO::CPU7, 0x04000214, 4, []() -> uint32_t { return if_arm7; }, [](uint32_t data, uint32_t mask)
+	{
+		LOG_DEBUG(IRQ, "Clearing ARM7 IF bits 0x%08x\n", data & mask);
+		if_arm7 &= ~(data & mask);
+	});
+
+	MMIO::Register(MMIO::CPU_BOTH, 0x04000130, 2, []() -> uint32_t { return keyinput; }, nullptr);
+
+	MMIO::Register(MMIO::CPU9, 0x04000300, 1, []() -> uint32_t { return postflg_arm9; },
+		[](uint32_t data, uint32_t) { postflg_arm9 |= data & 1; });
+	MMIO::Register(MMIO::CPU7, 0x04000300, 1, []() -> uint32_t { return postflg_arm7; },
+		[](uint32_t data, uint32_t) { postflg_arm7 |= data & 1; });
+
+	MMIO::Register(MMIO::CPU7, 0x04000301, 1, nullptr, [](uint32_t data, uint32_t)
+	{
+		switch (data)
+		{
+		case 0x80:
+			LOG_DEBUG(Bus, "Halted ARM7, IE: $%08x IF: $%08x\n", ie_arm7, if_arm7);
+			ARM7::Core::Halt();
+			break;
+		default:
+			LOG_ERROR(Bus, "Unknown HALTCNT state 0x%02x\n", data);
+			exit(1);
+		}
+	});
+
+	MMIO::Register(MMIO::CPU9, 0x04000247, 1, []() -> uint32_t { return wramcnt; }, [](uint32_t data, uint32_t)
+	{
+		if (wramcnt == (data & 3))
+			return;
+
+		wramcnt = data & 3;
+		UpdatePageTables();
+
+		// Blocks are keyed by address, so code compiled from the old layout would run in the new one
+		ARM9::Core::InvalidateAllCode();
+		ARM7::Core::InvalidateAllCode();
+	});
+
+	// Registers that are accepted but not emulated yet
+	MMIO::Register(MMIO::CPU9, 0x04000204, 2, nullptr, nullptr); // EXMEMCNT
+	MMIO::Register(MMIO::CPU7, 0x04000120, 4, nullptr, nullptr); // SIODATA32
+	MMIO::Register(MMIO::CPU7, 0x04000128, 4, nullptr, nullptr); // SIOCNT
+	MMIO::Register(MMIO::CPU7, 0x04000134, 2, nullptr, nullptr); // RCNT
+
+	GPU::RegisterMMIO();
+	DMA::RegisterMMIO();
+	Timers::RegisterMMIO();
+	Cartridge::RegisterMMIO();
+	Firmware::RegisterMMIO();
+	RTC::RegisterMMIO();
+}
+
 void InitMem()
 {
-	arm9_ram = new uint8_t[4*1024*1024];
-	arm7_ram = new uint8_t[4*1024*1024];
-	arm7_wram = new uint8_t[0x10000];
-	shared_wram = new uint8_t[32*1024];
+	mem_fd = memfd_create("nds-ram", 0);
+	if (mem_fd < 0 || ftruncate(mem_fd, mem_size) < 0)
+	{
+		LOG_ERROR(Bus, "Couldn't allocate guest memory\n");
+		exit(1);
+	}
+
+	// One linear view of every region for the emulator's own accesses
+	uint8_t* mem = (uint8_t*)mmap(nullptr, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+	if (mem == MAP_FAILED)
+	{
+		LOG_ERROR(Bus, "Couldn't map guest memory\n");
+		exit(1);
+	}
+
+	main_ram = mem + main_ram_offset;
+	shared_wram = mem + shared_wram_offset;
+	arm7_wram = mem + arm7_wram_offset;
+	dtcm = mem + dtcm_offset;
+	arm9_bios = mem + arm9_bios_offset;
+	arm7_bios = mem + arm7_bios_offset;
+
+	fastmem9 = MapArena(arena_size);
+	fastmem7 = MapArena(arena_size);
 
 	GPU::InitMem();
+	RegisterMMIO();
+
+	mem_initialized = true;
+	UpdatePageTables();
 }
 
 void Bus::AddARMBios(std::string file_name, bool is_arm9)
@@ -59,21 +289,25 @@ void Bus::AddARMBios(std::string file_name, bool is_arm9)
     size_t size = bios.tellg();
     bios.seekg(0, std::ios::beg);
 
+	if (!mem_initialized)
+		InitMem();
+
+	if (size > (is_arm9 ? 0x10000 : 0x4000))
+	{
+		LOG_ERROR(Bus, "BIOS %s is too large (%zu bytes)\n", file_name.c_str(), size);
+		exit(1);
+	}
+
     if (is_arm9)
     {
-        arm9_bios = new uint8_t[size];
         arm9_bios_size = size;
         bios.read((char*)arm9_bios, size);
     }
     else
     {
-        arm7_bios = new uint8_t[size];
 		arm7_bios_size = size;
         bios.read((char*)arm7_bios, size);
     }
-	
-	if (!mem_initialized)
-		InitMem();
 }
 
 struct NDSHeader
@@ -98,43 +332,51 @@ struct NDSHeader
 	uint32_t arm7_size;
 };
 
+// Copies a block the way a CPU would store it, straight into fastmem for every page that's RAM
+void CopyBlock(uint8_t* fastmem, const uint8_t* flags, void (*write8)(uint32_t, uint8_t), uint32_t addr, const uint8_t* src, uint32_t size)
+{
+	while (size)
+	{
+		uint32_t chunk = std::min<uint32_t>(size, (1 << page_shift) - (addr & ((1 << page_shift) - 1)));
+
+		if (flags[addr >> page_shift] & PAGE_WRITE)
+			memcpy(&fastmem[addr], src, chunk);
+		else
+		{
+			for (uint32_t i = 0; i < chunk; i++)
+				write8(addr + i, src[i]);
+		}
+
+		addr += chunk;
+		src += chunk;
+		size -= chunk;
+	}
+}
+
 void Bus::LoadNDS(std::string file)
 {
 	if (!mem_initialized)
 		InitMem();
 
-	NDSHeader* hdr = new NDSHeader;
-
-	std::ifstream cart(file);
-
-	size_t size = cart.tellg();
-	cart.seekg(0, std::ios::beg);
-	cart.read((char*)hdr, sizeof(NDSHeader));
+	// Only the header and the two binaries are read here, the rest is paged in as the game asks for it
+	Cartridge::LoadROM(file);
+	const uint8_t* buf = Cartridge::GetROM();
+	size_t size = Cartridge::GetROMSize();
 
-	printf("Loading cartridge with name %s\n", hdr->title);
-	printf("Loading ARM9 ROM to 0x%08x, %d bytes\n", hdr->arm9_ram_address, hdr->arm9_size);
+	const NDSHeader* hdr = (const NDSHeader*)buf;
 
-	cart.seekg(hdr->arm9_rom_offset, std::ios::beg);
-	for (uint32_t i = 0; i < hdr->arm9_size; i++)
+	if ((uint64_t)hdr->arm9_rom_offset + hdr->arm9_size > size || (uint64_t)hdr->arm7_rom_offset + hdr->arm7_size > size)
 	{
-		uint8_t data;
-		cart.read((char*)&data, 1);
-		Bus::Write8(hdr->arm9_ram_address + i, data);
+		LOG_ERROR(Bus, "ARM9 or ARM7 binary lies outside of %s\n", file.c_str());
+		exit(1);
 	}
 
-	printf("Loading ARM7 ROM to 0x%08x, %d bytes\n", hdr->arm7_ram_address, hdr->arm7_size);
-
-	cart.seekg(hdr->arm7_rom_offset, std::ios::beg);
-	for (uint32_t i = 0; i < hdr->arm7_size; i++)
-	{
-		uint8_t data;
-		cart.read((char*)&data, 1);
-		Bus::Write8_ARM7(hdr->arm7_ram_address + i, data);
-	}
+	LOG_INFO(Bus, "Loading cartridge with name %.12s\n", hdr->title);
+	LOG_INFO(Bus, "Loading ARM9 ROM to 0x%08x, %d bytes\n", hdr->arm9_ram_address, hdr->arm9_size);
+	CopyBlock(fastmem9, page_flags9, Bus::Write8, hdr->arm9_ram_address, &buf[hdr->arm9_rom_offset], hdr->arm9_size);
 
-	uint8_t* buf = new uint8_t[size];
-	cart.seekg(0, std::ios::beg);
-	cart.read((char*)buf, size);
+	LOG_INFO(Bus, "Loading ARM7 ROM to 0x%08x, %d bytes\n", hdr->arm7_ram_address, hdr->arm7_size);
+	CopyBlock(fastmem7, page_flags7, Bus::Write8_ARM7, hdr->arm7_ram_address, &buf[hdr->arm7_rom_offset], hdr->arm7_size);
 
 	ARM9::DirectBoot(hdr->arm9_entry_address);
 	ARM7::DirectBoot(hdr->arm7_entry_address);
@@ -159,6 +401,7 @@ void Bus::LoadNDS(std::string file)
 	postflg_arm9 = 1;
 
 	wramcnt = 3;
+	UpdatePageTables();
 
 	Bus::Write32_ARM7(0x27FF864, 0);
 	Bus::Write32_ARM7(0x27FF868, 0x7fc0 << 3);
@@ -169,459 +412,318 @@ void Bus::LoadNDS(std::string file)
 
 void Bus::Write32(uint32_t addr, uint32_t data)
 {
-	if (addr >= dtcm_start && addr < dtcm_start + 0x4000)
+	if (page_flags9[addr >> page_shift] & PAGE_WRITE)
 	{
-		*(uint32_t*)&dtcm[addr - dtcm_start] = data;
+		*(uint32_t*)&fastmem9[addr] = data;
 		return;
 	}
-	if ((addr & 0xFF000000) == 0x02000000)
+	if (addr >= 0x05000000 && addr < 0x08000000)
 	{
-		*(uint32_t*)&arm9_ram[addr & 0x3FFFFF] = data;
+		if (uint8_t* ptr = GPU::MapVideoMemory(addr, true))
+			*(uint32_t*)ptr = data;
 		return;
 	}
-	if (addr >= 0x06800000 && addr < 0x068A4000)
+	if ((addr & 0xFF000000) == 0x04000000)
 	{
-		GPU::WriteLCDC(addr, data & 0xFFFF);
-		GPU::WriteLCDC(addr+2, data >> 16);
+		MMIO::Write(true, addr, data, 4);
 		return;
 	}
 
-    switch (addr)
-    {
-    case 0x040001A0: // Ignore Gamecard ROM and SPI control
-		Cartridge::WriteAUXSPICNT(data);
-		return;
-    case 0x040001A4: // Ignore Gamecard bus ROMCTRL
-		Cartridge::WriteROMCTRL(data);
-        return;
-	case 0x04000208:
-		ime_arm9 = data;
-		return;
-	case 0x04000210:
-		ie_arm9 = data;
-		return;
-	case 0x04000214:
-		if_arm9 &= ~data;
-		return;
-	case 0x04000000:
-		GPU::WriteDISPCNT(data);
-		return;
-	case 0x04000304:
-		return;
-	case 0x04000240:
-		GPU::WriteVRAMCNT_A(data);
-		return;
-    }
-
-    printf("[emu/Bus]: Write32 0x%08x to unknown address 0x%08x\n", data, addr);
+    LOG_ERROR(Bus, "ARM9 Write32 0x%08x to unknown address 0x%08x\n", data, addr);
     exit(1);
 }
 
 void Bus::Write16(uint32_t addr, uint16_t data)
 {
-	if ((addr & 0xFF000000) == 0x02000000)
+	if (page_flags9[addr >> page_shift] & PAGE_WRITE)
 	{
-		*(uint16_t*)&arm9_ram[addr & 0x3FFFFF] = data;
+		*(uint16_t*)&fastmem9[addr] = data;
 		return;
 	}
-	if (addr >= 0x06800000 && addr < 0x068A4000)
+	if (addr >= 0x05000000 && addr < 0x08000000)
 	{
-		GPU::WriteLCDC(addr, data);
+		if (uint8_t* ptr = GPU::MapVideoMemory(addr, true))
+			*(uint16_t*)ptr = data;
 		return;
 	}
-	
-	switch (addr)
-	{
-	case 0x04000180:
-		arm7_ipcsync &= 0xFFF0;
-		arm7_ipcsync |= ((data & 0x0F00) >> 8);
-		arm9_ipcsync &= 0xB0FF;
-		arm9_ipcsync |= (data & 0x4F00);
-		printf("Sending value 0x%x to ARM7\n", (data & 0x0F00) >> 8);
-		if ((data & 0x2000) && (arm7_ipcsync & 0x4000))
-		{
-			printf("IPCSYNC IRQ here!\n");
-			exit(1);
-		}
-		return;
-	case 0x04000204: // Ignore EXMEMCNT
-		return;
-	case 0x04000304: // Ignore POWCNT1
-		return;
-	case 0x040000d0:
-		printf("Unhandled write to DMA2CNT\n");
-		return;
-	case 0x04000240:
-		GPU::WriteVRAMCNT_A(data);
+	if ((addr & 0xFF000000) == 0x04000000)
+	{
+		MMIO::Write(true, addr, data, 2);
 		return;
 	}
 
-    printf("[emu/Bus]: Write16 0x%04x to unknown address 0x%08x\n", data, addr);
+    LOG_ERROR(Bus, "ARM9 Write16 0x%04x to unknown address 0x%08x\n", data, addr);
     exit(1);
 }
 
 void Bus::Write8(uint32_t addr, uint8_t data)
 {
-	if (addr >= 0x02000000 && addr < 0x03000000)
+	if (page_flags9[addr >> page_shift] & PAGE_WRITE)
 	{
-		arm9_ram[addr & 0x3FFFFF] = data;
+		fastmem9[addr] = data;
 		return;
 	}
-
-	switch (addr)
-	{
-	case 0x04000208:
-		ime_arm9 = data;
+	// Palette RAM, VRAM and OAM ignore byte writes
+	if (addr >= 0x05000000 && addr < 0x08000000)
 		return;
-	case 0x04000247:
-		wramcnt = data & 3;
-		return;
-	case 0x04000240:
-		GPU::WriteVRAMCNT_A(data);
-		return;
-	case 0x04000241:
-		GPU::WriteVRAMCNT_B(data);
+	if ((addr & 0xFF000000) == 0x04000000)
+	{
+		MMIO::Write(true, addr, data, 1);
 		return;
 	}
 
-    printf("[emu/Bus]: Write8 0x%02x to unknown address 0x%08x\n", data, addr);
+    LOG_ERROR(Bus, "ARM9 Write8 0x%02x to unknown address 0x%08x\n", data, addr);
     exit(1);
 }
 
 uint32_t Bus::Read32(uint32_t addr)
 {
-    if (addr >= 0xFFFF0000 && addr < 0xFFFF0000 + arm9_bios_size)
-        return *(uint32_t*)&arm9_bios[addr - 0xFFFF0000];
-	if (addr >= dtcm_start && addr < dtcm_start + 0x4000)
-		return *(uint32_t*)&dtcm[addr - dtcm_start];
-	if ((addr & 0xFF000000) == 0x02000000)
+	if (page_flags9[addr >> page_shift] & PAGE_READ)
+		return *(uint32_t*)&fastmem9[addr];
+	if ((addr & 0xFF000000) == 0x04000000)
+		return MMIO::Read(true, addr, 4);
+	if (addr >= 0x05000000 && addr < 0x08000000)
 	{
-		return *(uint32_t*)&arm9_ram[addr & 0x3FFFFF];
+		uint8_t* ptr = GPU::MapVideoMemory(addr, false);
+		return ptr ? *(uint32_t*)ptr : 0;
 	}
 
-    printf("[emu/Bus]: Read32 from unknown address 0x%08x\n", addr);
+    LOG_ERROR(Bus, "ARM9 Read32 from unknown address 0x%08x\n", addr);
    	exit(1);
 }
 
 uint16_t Bus::Read16(uint32_t addr)
 {
-	if (addr >= 0xFFFF0000 && addr < 0xFFFF0000 + arm9_bios_size)
-        return *(uint16_t*)&arm9_bios[addr - 0xFFFF0000];
-	if ((addr & 0xFF000000) == 0x02000000)
-		return *(uint16_t*)&arm9_ram[addr & 0x3FFFFF];
-	
-	switch (addr)
+	if (page_flags9[addr >> page_shift] & PAGE_READ)
+		return *(uint16_t*)&fastmem9[addr];
+	if ((addr & 0xFF000000) == 0x04000000)
+		return MMIO::Read(true, addr, 2);
+	if (addr >= 0x05000000 && addr < 0x08000000)
 	{
-	case 0x04000180:
-		return arm9_ipcsync;
-	case 0x04000004:
-		return GPU::ReadDIPSTAT();
-	case 0x04000130:
-		return keyinput;
+		uint8_t* ptr = GPU::MapVideoMemory(addr, false);
+		return ptr ? *(uint16_t*)ptr : 0;
 	}
 
-    printf("[emu/Bus]: Read16 from unknown address 0x%08x\n", addr);
+    LOG_ERROR(Bus, "ARM9 Read16 from unknown address 0x%08x\n", addr);
     exit(1);
 }
 
 uint8_t Bus::Read8(uint32_t addr)
 {
-	if (addr >= 0x02000000 && addr < 0x03000000)
-		return arm9_ram[addr & 0x3FFFFF];
-
-    switch (addr)
-    {
-    case 0x04000300:
-        return postflg_arm9;
-    }
+	if (page_flags9[addr >> page_shift] & PAGE_READ)
+		return fastmem9[addr];
+	if ((addr & 0xFF000000) == 0x04000000)
+		return MMIO::Read(true, addr, 1);
+	if (addr >= 0x05000000 && addr < 0x08000000)
+	{
+		uint8_t* ptr = GPU::MapVideoMemory(addr, false);
+		return ptr ? *(uint8_t*)ptr : 0;
+	}
 
-    printf("[emu/Bus]: Read8 from unknown address 0x%08x\n", addr);
+    LOG_ERROR(Bus, "ARM9 Read8 from unknown address 0x%08x\n", addr);
     exit(1);
 }
 
 void Bus::Write8_ARM7(uint32_t addr, uint8_t data)
 {
-	if (addr >= 0x03800000 && addr < 0x04000000)
+	if (page_flags7[addr >> page_shift] & PAGE_WRITE)
 	{
-		arm7_wram[addr & 0xFFFF] = data;
+		fastmem7[addr] = data;
 		return;
 	}
 	if (addr < 0x4000)
 		return;
-
-	switch (addr)
+	if ((addr & 0xFF000000) == 0x06000000)
 	{
-	case 0x04000208:
-		ime_arm7 = data;
-		return;
-	case 0x040001A1:
-	{
-		uint32_t spicnt = Cartridge::ReadAUXSPICNT();
-		spicnt &= 0xFFFF00FF;
-		spicnt |= (data << 8);
-		Cartridge::WriteAUXSPICNT(spicnt);
+		if (uint8_t* ptr = GPU::MapARM7VRAM(addr, true))
+			*ptr = data;
 		return;
 	}
-	case 0x04000138:
-		RTC::Write(data, true);
-		return;
-	case 0x040001A8 ... 0x040001AF:
-		Cartridge::SendCommandByte(data, addr - 0x040001A8);
-		return;
-	case 0x040001c2:
-		Firmware::WriteSPIData(data);
-		return;
-	case 0x04000301:
+	if ((addr & 0xFF000000) == 0x04000000)
 	{
-		switch (data)
-		{
-		case 0x80:
-			printf("Halted ARM7\n");
-			printf("IE: $%08x\n", ie_arm7);
-			printf("IF: $%08x\n", if_arm7);
-			exit(1);
-			break;
-		default:
-			printf("Unknown HALTCNT state 0x%02x\n", data);
-			exit(1);
-		}
+		MMIO::Write(false, addr, data, 1);
 		return;
 	}
-	}
 
-	printf("[emu/ARM7]: Write8 0x%02x to unknown addr 0x%08x\n", data, addr);
+	LOG_ERROR(Bus, "ARM7 Write8 0x%02x to unknown address 0x%08x\n", data, addr);
 	exit(1);
 }
 
 void Bus::Write16_ARM7(uint32_t addr, uint16_t data)
 {
-	if ((addr & 0xFF000000) == 0x02000000)
+	if (page_flags7[addr >> page_shift] & PAGE_WRITE)
 	{
-		*(uint16_t*)&arm7_ram[addr & 0x3FFFFF] = data;
+		*(uint16_t*)&fastmem7[addr] = data;
 		return;
 	}
-	else if (addr >= 0x03000000 && addr < 0x03800000)
+	if ((addr & 0xFF000000) == 0x06000000)
 	{
-		switch (wramcnt)
-		{
-		case 3:
-			*(uint16_t*)&shared_wram[addr & 0x7fff] = data;
-			return;
-		default:
-			printf("Unknown wramcnt configuration %d\n", wramcnt);
-			exit(1);
-		}
+		if (uint8_t* ptr = GPU::MapARM7VRAM(addr, true))
+			*(uint16_t*)ptr = data;
+		return;
 	}
-
-	switch (addr)
+	if ((addr & 0xFF000000) == 0x04000000)
 	{
-	case 0x04000180:
-		arm9_ipcsync &= 0xFFF0;
-		arm9_ipcsync |= ((data & 0x0F00) >> 8);
-		arm7_ipcsync &= 0xB0FF;
-		arm7_ipcsync |= (data & 0x4F00);
-		if ((data & 0x2000) && (arm9_ipcsync & 0x4000))
-		{
-			printf("IPCSYNC IRQ here!\n");
-			exit(1);
-		}
-		return;
-	case 0x040001c0:
-		Firmware::WriteSPICNT(data);
-		return;
-	case 0x040001c2:
-		Firmware::WriteSPIData(data);
-		return;
-	case 0x04000134:
-	case 0x04000128:
-		return;
-	case 0x04000100:
-	case 0x04000102:
-	case 0x04000104:
-	case 0x04000106:
-	case 0x04000108:
-	case 0x0400010A:
-	case 0x0400010C:
-	case 0x0400010E:
+		MMIO::Write(false, addr, data, 2);
 		return;
 	}
 
-	printf("[emu/ARM7]: Write16 0x%04x to unknown addr 0x%08x\n", data, addr);
+	LOG_ERROR(Bus, "ARM7 Write16 0x%04x to unknown address 0x%08x\n", data, addr);
 	exit(1);
 }
 
 void Bus::Write32_ARM7(uint32_t addr, uint32_t data)
 {
-	if (addr == 0x0380FFF8)
-		printf("Writing to BIOS Interrupt flags 0x%08x\n", data);
-
-	if (addr >= 0x03800000 && addr < 0x04000000)
+	if (page_flags7[addr >> page_shift] & PAGE_WRITE)
 	{
-		*(uint32_t*)&arm7_wram[addr & 0xFFFF] = data;
+		*(uint32_t*)&fastmem7[addr] = data;
 		return;
 	}
-	else if (addr >= 0x03000000 && addr < 0x03800000)
-	{
-		switch (wramcnt)
-		{
-		case 3:
-			*(uint32_t*)&shared_wram[addr & 0x7fff] = data;
-			return;
-		default:
-			printf("Unknown WRAM configuration %d\n", wramcnt);
-			exit(1);
-		}
-	}
-	if ((addr & 0xFF000000) == 0x02000000)
+	if ((addr & 0xFF000000) == 0x06000000)
 	{
-		*(uint32_t*)&arm7_ram[addr & 0x3FFFFF] = data;
+		if (uint8_t* ptr = GPU::MapARM7VRAM(addr, true))
+			*(uint32_t*)ptr = data;
 		return;
 	}
-
-	switch (addr)
+	if ((addr & 0xFF000000) == 0x04000000)
 	{
-	case 0x04000208:
-		ime_arm7 = data;
-		return;
-	case 0x04000210:
-		printf("Writing 0x%08x to ARM7's IE\n", data);
-		ie_arm7 = data;
-		return;
-	case 0x04000214:
-		printf("Clearing IF bits 0x%08x\n", data);
-		if_arm7 &= ~data;
-		return;
-	case 0x04000004:
-		GPU::WriteDISPCNT(data);
-		return;
-	case 0x040001A4:
-		Cartridge::WriteROMCTRL(data);
-		return;
-	case 0x04000100 ... 0x0400010C:
-		return;
-	case 0x04000120:
+		MMIO::Write(false, addr, data, 4);
 		return;
 	}
 
-	printf("[emu/ARM7]: Write32 0x%08x to unknown addr 0x%08x\n", data, addr);
+	LOG_ERROR(Bus, "ARM7 Write32 0x%08x to unknown address 0x%08x\n", data, addr);
 	exit(1);
 }
 
 uint32_t Bus::Read32_ARM7(uint32_t addr)
 {
-	if (addr < arm7_bios_size)
-		return *(uint32_t*)&arm7_bios[addr];
-	if (addr >= 0x03800000 && addr < 0x04000000)
-		return *(uint32_t*)&arm7_wram[addr & 0xFFFF];
-	if (addr >= 0x02000000 && addr < 0x03000000)
-		return *(uint32_t*)&arm7_ram[addr & 0x3FFFFF];
-	if (addr >= 0x03000000 && addr < 0x03800000)
+	if (page_flags7[addr >> page_shift] & PAGE_READ)
+		return *(uint32_t*)&fastmem7[addr];
+	if ((addr & 0xFF000000) == 0x04000000)
+		return MMIO::Read(false, addr, 4);
+	if ((addr & 0xFF000000) == 0x06000000)
 	{
-		switch (wramcnt)
-		{
-		case 3:
-			return *(uint32_t*)&shared_wram[addr & 0x7fff];
-		default:
-			printf("Unknown wramcnt configuration %d\n", wramcnt);
-			exit(1);
-		}
+		uint8_t* ptr = GPU::MapARM7VRAM(addr, false);
+		return ptr ? *(uint32_t*)ptr : 0;
 	}
+	
+	LOG_ERROR(Bus, "ARM7 Read32 from unknown address 0x%08x\n", addr);
+	exit(1);
+}
 
-	switch (addr)
+uint16_t Bus::Read16_ARM7(uint32_t addr)
+{
+	if (page_flags7[addr >> page_shift] & PAGE_READ)
+		return *(uint16_t*)&fastmem7[addr];
+	if ((addr & 0xFF000000) == 0x04000000)
+		return MMIO::Read(false, addr, 2);
+	if ((addr & 0xFF000000) == 0x06000000)
 	{
-    case 0x040001A4:
-		return Cartridge::ReadROMCTRL();
-	case 0x04100010:
-		return Cartridge::ReadDataOut();
-	case 0x040001c0:
-		return 0;
-	case 0x04000120:
-		return 0;
-	case 0x04000210:
-		return ie_arm7;
-	case 0x04000208:
-		return ime_arm7;
+		uint8_t* ptr = GPU::MapARM7VRAM(addr, false);
+		return ptr ? *(uint16_t*)ptr : 0;
 	}
 	
-	printf("[emu/ARM7]: Read32 from unknown addr 0x%08x\n", addr);
+	LOG_ERROR(Bus, "ARM7 Read16 from unknown address 0x%08x\n", addr);
 	exit(1);
 }
 
-uint16_t Bus::Read16_ARM7(uint32_t addr)
+uint8_t Bus::Read8_ARM7(uint32_t addr)
 {
-	if (addr < arm7_bios_size)
-		return *(uint16_t*)&arm7_bios[addr];
-	if (addr >= 0x03000000 && addr < 0x03800000)
+	if (page_flags7[addr >> page_shift] & PAGE_READ)
+		return fastmem7[addr];
+	if ((addr & 0xFF000000) == 0x04000000)
+		return MMIO::Read(false, addr, 1);
+	if ((addr & 0xFF000000) == 0x06000000)
 	{
-		switch (wramcnt)
-		{
-		case 3:
-			return *(uint16_t*)&shared_wram[addr & 0x7fff];
-		default:
-			printf("Unknown wramcnt configuration %d\n", wramcnt);
-			exit(1);
-		}
+		uint8_t* ptr = GPU::MapARM7VRAM(addr, false);
+		return ptr ? *ptr : 0;
 	}
-	if (addr >= 0x02000000 && addr < 0x03000000)
-		return *(uint32_t*)&arm7_ram[addr & 0x3FFFFF];
-	if (addr >= 0x03800000 && addr < 0x04000000)
-		return *(uint16_t*)&arm7_wram[addr & 0xFFFF];
-	
-	
-	switch (addr)
+
+    LOG_ERROR(Bus, "ARM7 Read8 from unknown address 0x%08x\n", addr);
+    exit(1);
+}
+
+uint8_t* Bus::GetHostPointer(bool is_arm9, uint32_t addr, bool write)
+{
+	uint8_t flag = write ? PAGE_WRITE : PAGE_READ;
+
+	if (is_arm9)
 	{
-	case 0x04000180:
-		return arm7_ipcsync;
-	case 0x04000128:
-		return 0;
+		if (page_flags9[addr >> page_shift] & flag)
+			return &fastmem9[addr];
+		if (addr >= 0x05000000 && addr < 0x08000000)
+			return GPU::MapVideoMemory(addr, write);
+		return nullptr;
 	}
-	
-	printf("[emu/ARM7]: Read16 from unknown addr 0x%08x\n", addr);
-	exit(1);
+
+	if (page_flags7[addr >> page_shift] & flag)
+		return &fastmem7[addr];
+	if ((addr & 0xFF000000) == 0x06000000)
+		return GPU::MapARM7VRAM(addr, write);
+	return nullptr;
 }
 
-uint8_t Bus::Read8_ARM7(uint32_t addr)
+uint32_t Bus::CodeAddress(bool is_arm9, uint32_t addr)
 {
-	if (addr >= 0x03800000 && addr < 0x04000000)
-		return arm7_wram[addr & 0xFFFF];
-	if (addr >= 0x03000000 && addr < 0x03800000)
+	switch (addr >> 24)
 	{
-		switch (wramcnt)
+	case 0x02:
+		return addr & 0x023FFFFF;
+	case 0x03:
+		// Shared WRAM folds onto 0x03000000, the ARM7's own WRAM onto 0x03800000
+		if (!is_arm9 && (addr >= 0x03800000 || wramcnt == 0))
+			return 0x03800000 | (addr & 0xFFFF);
+
+		// The ARM9's banks are the ones WRAMCNT doesn't give the ARM7
+		switch (wramcnt ^ (is_arm9 ? 3 : 0))
 		{
+		case 1:
+			return 0x03000000 | (addr & 0x3FFF);
+		case 2:
+			return 0x03004000 | (addr & 0x3FFF);
 		case 3:
-			return shared_wram[addr & 0x7fff];
-		default:
-			printf("Unknown wramcnt configuration %d\n", wramcnt);
-			exit(1);
+			return 0x03000000 | (addr & 0x7FFF);
 		}
+		return addr;
+	default:
+		return addr;
 	}
-	
-	switch (addr)
-    {
-    case 0x04000300:
-        return postflg_arm7;
-	case 0x04100010 ... 0x04100013:
-		return Cartridge::ReadDataOut(addr - 0x04100010);
-	case 0x40001C2:
-		return Firmware::ReadSPIData();
-    }
-
-    printf("[emu/ARM7]: Read8 from unknown address 0x%08x\n", addr);
-    exit(1);
 }
 
 void Bus::RemapDTCM(uint32_t addr)
 {
-	dtcm_start = addr;
+	// The hardware aligns the base to the region's size, which also keeps it on a fastmem page
+	dtcm_start = addr & ~0x3FFF;
+	UpdatePageTables();
+}
+
+void Bus::TriggerInterrupt9(int i)
+{
+	if_arm9 |= (1 << i);
+}
+
+bool Bus::IsInterruptAvailable9()
+{
+	return ime_arm9 && (if_arm9 & ie_arm9);
+}
+
+bool Bus::IsInterruptPending9()
+{
+	return if_arm9 & ie_arm9;
 }
 
 void Bus::TriggerInterrupt7(int i)
 {
-	printf("Triggering interrupt %d (0x%08x)\n", i, (1 << i));
+	LOG_TRACE(IRQ, "Triggering ARM7 interrupt %d (0x%08x)\n", i, (1 << i));
 	if_arm7 |= (1 << i);
 }
 
 bool Bus::IsInterruptAvailable7()
+{
+	return ime_arm7 && (if_arm7 & ie_arm7);
+}
+
+bool Bus::IsInterruptPending7()
 {
 	return if_arm7 & ie_arm7;
 }
@@ -647,7 +749,7 @@ void Bus::Dump()
 
 	for (int i = 0; i < 4*1024*1024; i++)
 	{
-		out << arm9_ram[i];
+		out << main_ram[i];
 	}
 
 	out.close();
@@ -661,15 +763,6 @@ void Bus::Dump()
 
 	out.close();
 
-	out.open("arm7_ram.dump");
-
-	for (int i = 0; i < 4*1024*1024; i++)
-	{
-		out << arm7_ram[i];
-	}
-
-	out.close();
-
 	out.open("shared_wram.dump");
 
 	for (int i = 0; i < 32*1024; i++)
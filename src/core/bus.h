@@ -28,8 +28,21 @@ uint8_t Read8_ARM7(uint32_t addr);
 
 void RemapDTCM(uint32_t addr);
 
+// Host pointer for addr if it's RAM or video memory, good up to the next 1 KiB boundary.
+// Null for I/O and anything unmapped. Pass write if the caller is going to store through it
+uint8_t* GetHostPointer(bool is_arm9, uint32_t addr, bool write);
+
+// Folds the mirrors of main RAM and WRAM, as seen by that CPU, onto one address per byte of memory
+uint32_t CodeAddress(bool is_arm9, uint32_t addr);
+
+// Available means it would be taken, pending only means IE & IF, which is what wakes a halted CPU
+void TriggerInterrupt9(int i);
+bool IsInterruptAvailable9();
+bool IsInterruptPending9();
+
 void TriggerInterrupt7(int i);
 bool IsInterruptAvailable7();
+bool IsInterruptPending7();
 
 enum class Keys
 {
@@ -0,0 +1,2566 @@
+#include <src/core/cpu/arm_core.h>
+#include <src/core/cpu/thumb.h>
+#include <src/core/arm9/arm9.h>
+#include <src/core/arm7/arm7.h>
+#include <src/core/log.h>
+
+#include <bit>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+const char* data_processing_names[16] =
+{
+	"and", "eor", "sub", "rsb", "add", "adc", "sbc", "rsc",
+	"tst", "teq", "cmp", "cmn", "orr", "mov", "bic", "mvn"
+};
+
+const char* thumb_alu_names[16] =
+{
+	"and", "eor", "lsl", "lsr", "asr", "adc", "sbc", "ror",
+	"tst", "neg", "cmp", "cmn", "orr", "mul", "bic", "mvn"
+};
+
+// Bit NZCV of each condition's entry is set if it passes with those flags
+constexpr std::array<uint16_t, 16> condition_table = []
+{
+	std::array<uint16_t, 16> table = {};
+
+	for (int flags = 0; flags < 16; flags++)
+	{
+		bool n = flags & 8;
+		bool z = flags & 4;
+		bool c = flags & 2;
+		bool v = flags & 1;
+
+		bool passed[16] =
+		{
+			z, !z, c, !c, n, !n, v, !v,
+			c && !z, !c || z, n == v, n != v, !z && n == v, z || n != v, true, false,
+		};
+
+		for (int cond = 0; cond < 16; cond++)
+			table[cond] |= passed[cond] << flags;
+	}
+
+	return table;
+}();
+
+// Clamps to the signed 32-bit range, returns true if the value had to be clamped
+bool Saturate(int64_t& value)
+{
+	if (value > INT32_MAX)
+	{
+		value = INT32_MAX;
+		return true;
+	}
+	if (value < INT32_MIN)
+	{
+		value = INT32_MIN;
+		return true;
+	}
+	return false;
+}
+
+}
+
+template <ARMVersion Version, class BusInterface>
+uint32_t& ARMCore<Version, BusInterface>::GetReg(int reg)
+{
+	return r[reg];
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::SetReg(int reg, uint32_t data)
+{
+	r[reg] = data;
+}
+
+// Instructions are fetched when the block at the new PC is looked up, so refilling the
+// pipeline only has to leave PC two instructions ahead like the real one would
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::FlushPipeline()
+{
+	if (cpsr.flags.t)
+		GetReg(15) = (GetReg(15) & ~1) + 4;
+	else
+		GetReg(15) = (GetReg(15) & ~3) + 8;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::Reset(uint32_t entry)
+{
+	if (direct_booted)
+		return;
+
+	memset(r, 0, sizeof(r));
+	memset(r_banked, 0, sizeof(r_banked));
+	bank = BANK_USR;
+
+	cpsr.val = 0;
+	flag_op = FlagOp::None;
+	SwitchMode(MODE_SVC);
+	cpsr.flags.i = 1;
+	cpsr.flags.f = 1;
+
+	halted = idle = false;
+	idle_key = 2;
+
+	SetReg(15, entry);
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::DirectBoot(uint32_t entry, uint32_t sp, uint32_t sp_irq, uint32_t sp_svc)
+{
+	memset(r, 0, sizeof(r));
+	memset(r_banked, 0, sizeof(r_banked));
+	bank = BANK_USR;
+
+	cpsr.val = 0;
+	flag_op = FlagOp::None;
+	SwitchMode(MODE_SYS);
+
+	r_banked[BANK_IRQ][13 - 8] = sp_irq;
+	r_banked[BANK_SVC][13 - 8] = sp_svc;
+
+	SetReg(12, entry);
+	SetReg(13, sp);
+	SetReg(14, entry);
+	SetReg(15, entry);
+
+	direct_booted = true;
+
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::SwitchMode(uint32_t mode)
+{
+	int new_bank;
+
+	switch (mode)
+	{
+	case MODE_USR:
+	case MODE_SYS:
+		new_bank = BANK_USR;
+		cur_spsr = nullptr;
+		break;
+	case MODE_FIQ:
+		new_bank = BANK_FIQ;
+		cur_spsr = &spsr_fiq;
+		break;
+	case MODE_IRQ:
+		new_bank = BANK_IRQ;
+		cur_spsr = &spsr_irq;
+		break;
+	case MODE_SVC:
+		new_bank = BANK_SVC;
+		cur_spsr = &spsr_svc;
+		break;
+	case MODE_ABT:
+		new_bank = BANK_ABT;
+		cur_spsr = &spsr_abt;
+		break;
+	case MODE_UND:
+		new_bank = BANK_UND;
+		cur_spsr = &spsr_und;
+		break;
+	default:
+		LOG_ERROR(CPU, "%s switch to unknown mode 0x%02x\n", name, mode);
+		exit(1);
+	}
+
+	cpsr.flags.mode = mode;
+
+	if (new_bank == bank)
+		return;
+
+	// r8-r12 belong to User mode everywhere but FIQ
+	if (bank == BANK_FIQ)
+		memcpy(r_banked[BANK_FIQ], &r[8], 7 * sizeof(uint32_t));
+	else
+	{
+		memcpy(r_banked[BANK_USR], &r[8], 5 * sizeof(uint32_t));
+		memcpy(&r_banked[bank][13 - 8], &r[13], 2 * sizeof(uint32_t));
+	}
+
+	if (new_bank == BANK_FIQ)
+		memcpy(&r[8], r_banked[BANK_FIQ], 7 * sizeof(uint32_t));
+	else
+	{
+		memcpy(&r[8], r_banked[BANK_USR], 5 * sizeof(uint32_t));
+		memcpy(&r[13], &r_banked[new_bank][13 - 8], 2 * sizeof(uint32_t));
+	}
+
+	bank = new_bank;
+}
+
+// Where User mode's copy of a register is while another mode runs
+template <ARMVersion Version, class BusInterface>
+uint32_t& ARMCore<Version, BusInterface>::UserReg(int reg)
+{
+	if (reg < 8 || reg == 15 || bank == BANK_USR || (bank != BANK_FIQ && reg < 13))
+		return r[reg];
+
+	return r_banked[BANK_USR][reg - 8];
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::RestoreCPSR()
+{
+	// User and System mode have no SPSR to return from
+	if (!cur_spsr)
+		return;
+
+	PSR spsr = *cur_spsr;
+	SwitchMode(spsr.flags.mode);
+	cpsr.val = spsr.val;
+	flag_op = FlagOp::None;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::RaiseException(uint32_t mode, uint32_t vector, uint32_t return_address)
+{
+	SyncFlags();
+	PSR old = cpsr;
+
+	SwitchMode(mode);
+	cur_spsr->val = old.val;
+
+	SetReg(14, return_address);
+	cpsr.flags.t = 0;
+	cpsr.flags.i = 1;
+
+	SetReg(15, BusInterface::ExceptionBase() + vector);
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::BranchExchange(uint32_t addr)
+{
+	cpsr.flags.t = addr & 1;
+	SetReg(15, addr);
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::CondPassed(uint8_t cond)
+{
+	return (condition_table[cond] >> NZCV()) & 1;
+}
+
+// The four flags with N in bit 3, the way they sit at the top of the CPSR
+template <ARMVersion Version, class BusInterface>
+uint8_t ARMCore<Version, BusInterface>::NZCV()
+{
+	if (flag_op == FlagOp::None)
+		return cpsr.val >> 28;
+
+	return (FlagN() << 3) | (FlagZ() << 2) | (Carry() << 1) | Overflow();
+}
+
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::FlagN()
+{
+	return flag_op == FlagOp::None ? cpsr.flags.n : flag_result >> 31;
+}
+
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::FlagZ()
+{
+	return flag_op == FlagOp::None ? cpsr.flags.z : flag_result == 0;
+}
+
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::Carry()
+{
+	switch (flag_op)
+	{
+	case FlagOp::Logic:
+		return flag_carry;
+	case FlagOp::Add:
+		return ((uint64_t)flag_a + flag_b + flag_carry) >> 32;
+	case FlagOp::Sub:
+		return (uint64_t)flag_a >= (uint64_t)flag_b + !flag_carry;
+	default:
+		return cpsr.flags.c;
+	}
+}
+
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::Overflow()
+{
+	switch (flag_op)
+	{
+	case FlagOp::Logic:
+		return flag_v;
+	case FlagOp::Add:
+		return (~(flag_a ^ flag_b) & (flag_a ^ flag_result)) >> 31;
+	case FlagOp::Sub:
+		return ((flag_a ^ flag_b) & (flag_a ^ flag_result)) >> 31;
+	default:
+		return cpsr.flags.v;
+	}
+}
+
+// Writes pending flags back into cpsr, for anything that reads or replaces it whole
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::SyncFlags()
+{
+	if (flag_op == FlagOp::None)
+		return;
+
+	cpsr.val = (cpsr.val & 0x0FFFFFFF) | (NZCV() << 28);
+	flag_op = FlagOp::None;
+}
+
+// For generated code that sets N and Z but keeps C or V. The flags are left in Logic form,
+// flag_result has to be written straight after
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::PrepareLogicFlags()
+{
+	flag_v = Overflow();
+	flag_carry = Carry();
+	flag_op = FlagOp::Logic;
+}
+
+// Leaves C and V alone
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::SetNZ(uint32_t result)
+{
+	SetLogicFlags(result, Carry());
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::SetLogicFlags(uint32_t result, bool carry)
+{
+	flag_v = Overflow();
+	flag_carry = carry;
+	flag_result = result;
+	flag_op = FlagOp::Logic;
+}
+
+template <ARMVersion Version, class BusInterface>
+uint32_t ARMCore<Version, BusInterface>::Add(uint32_t a, uint32_t b, bool carry, bool s)
+{
+	uint32_t result = a + b + carry;
+
+	if (s)
+	{
+		flag_a = a;
+		flag_b = b;
+		flag_carry = carry;
+		flag_result = result;
+		flag_op = FlagOp::Add;
+	}
+
+	return result;
+}
+
+// Computes a - b - !carry, so plain subtraction passes carry = true
+template <ARMVersion Version, class BusInterface>
+uint32_t ARMCore<Version, BusInterface>::Sub(uint32_t a, uint32_t b, bool carry, bool s)
+{
+	uint32_t result = a - b - !carry;
+
+	if (s)
+	{
+		flag_a = a;
+		flag_b = b;
+		flag_carry = carry;
+		flag_result = result;
+		flag_op = FlagOp::Sub;
+	}
+
+	return result;
+}
+
+// Barrel shifter. carry holds the incoming C flag and receives the shifter carry-out
+template <ARMVersion Version, class BusInterface>
+uint32_t ARMCore<Version, BusInterface>::Shift(uint32_t value, int type, uint32_t amount, bool immediate, bool& carry)
+{
+	// An immediate amount of 0 encodes LSR #32, ASR #32 and RRX
+	if (immediate && type != 0 && amount == 0)
+	{
+		if (type == 3)
+		{
+			bool c = value & 1;
+			value = (value >> 1) | ((uint32_t)carry << 31);
+			carry = c;
+			return value;
+		}
+		amount = 32;
+	}
+
+	if (amount == 0)
+		return value;
+
+	switch (type)
+	{
+	case 0:
+		if (amount < 32)
+		{
+			carry = (value >> (32 - amount)) & 1;
+			return value << amount;
+		}
+		carry = amount == 32 ? value & 1 : 0;
+		return 0;
+	case 1:
+		if (amount < 32)
+		{
+			carry = (value >> (amount - 1)) & 1;
+			return value >> amount;
+		}
+		carry = amount == 32 ? value >> 31 : 0;
+		return 0;
+	case 2:
+		if (amount < 32)
+		{
+			carry = (value >> (amount - 1)) & 1;
+			return (int32_t)value >> amount;
+		}
+		carry = value >> 31;
+		return carry ? 0xFFFFFFFF : 0;
+	default:
+		amount &= 31;
+		if (amount == 0)
+		{
+			carry = value >> 31;
+			return value;
+		}
+		carry = (value >> (amount - 1)) & 1;
+		return std::rotr(value, amount);
+	}
+}
+
+// Misaligned word loads rotate the aligned word so the addressed byte ends up in bits 0-7
+template <ARMVersion Version, class BusInterface>
+uint32_t ARMCore<Version, BusInterface>::ReadRotated32(uint32_t addr)
+{
+	return std::rotr(BusInterface::Read32(addr & ~3), (addr & 3) * 8);
+}
+
+// The ARM7 rotates misaligned halfword loads too, the ARM9 simply ignores bit 0
+template <ARMVersion Version, class BusInterface>
+uint32_t ARMCore<Version, BusInterface>::ReadRotated16(uint32_t addr)
+{
+	uint32_t value = BusInterface::Read16(addr & ~1);
+
+	if constexpr (Version == ARMVersion::ARMv4T)
+		return std::rotr(value, (addr & 1) * 8);
+
+	return value;
+}
+
+template <ARMVersion Version, class BusInterface>
+uint32_t ARMCore<Version, BusInterface>::ReadSigned16(uint32_t addr)
+{
+	// A misaligned LDRSH on the ARM7 loads a sign-extended byte instead
+	if constexpr (Version == ARMVersion::ARMv4T)
+	{
+		if (addr & 1)
+			return (int8_t)BusInterface::Read8(addr);
+	}
+
+	return (int16_t)BusInterface::Read16(addr & ~1);
+}
+
+template <ARMVersion Version, class BusInterface>
+constexpr typename ARMCore<Version, BusInterface>::ARMHandler ARMCore<Version, BusInterface>::DecodeARM(uint32_t i)
+{
+	uint32_t op = (i >> 20) & 0xFF;
+	uint32_t lo = (i >> 4) & 0xF;
+
+	if ((op & 0xE0) == 0x00)
+	{
+		// Bits 7 and 4 set: multiplies, swaps and the extra load/store space
+		if ((lo & 0b1001) == 0b1001)
+		{
+			if (lo == 0b1001)
+			{
+				if ((op & 0xFC) == 0x00)
+					return &ARMMultiply;
+				if ((op & 0xF8) == 0x08)
+					return &ARMMultiplyLong;
+				if ((op & 0xFB) == 0x10)
+					return &ARMSwap;
+				return &ARMUndefined;
+			}
+
+			// LDRD/STRD live where a store would use a signed transfer type
+			if (!(op & 1) && (lo & 0b0100))
+			{
+				if constexpr (Version == ARMVersion::ARMv5TE)
+					return &ARMDoublewordTransfer;
+				return &ARMUndefined;
+			}
+
+			return &ARMHalfwordTransfer;
+		}
+
+		// Comparisons without S are the miscellaneous instruction space
+		if ((op & 0xF9) == 0x10)
+		{
+			if (lo == 0b0000)
+				return (op & 0x02) ? &ARMPSRTransferMSR : &ARMPSRTransferMRS;
+			if (lo == 0b0001 && op == 0x12)
+				return &ARMBranchExchange;
+
+			if constexpr (Version == ARMVersion::ARMv5TE)
+			{
+				if (lo == 0b0011 && op == 0x12)
+					return &ARMBranchLinkExchange;
+				if (lo == 0b0001 && op == 0x16)
+					return &ARMCountLeadingZeros;
+				if (lo == 0b0101)
+					return &ARMSaturatingArithmetic;
+				if ((lo & 0b1001) == 0b1000)
+					return &ARMSignedMultiplyHalfword;
+			}
+
+			return &ARMUndefined;
+		}
+
+		return &ARMDataProcessing;
+	}
+
+	if ((op & 0xE0) == 0x20)
+	{
+		if ((op & 0xFB) == 0x32)
+			return &ARMPSRTransferMSR;
+		if ((op & 0xF9) == 0x30)
+			return &ARMUndefined;
+		return &ARMDataProcessing;
+	}
+
+	if ((op & 0xE0) == 0x40)
+		return &ARMSingleDataTransfer;
+	if ((op & 0xE0) == 0x60)
+		return (lo & 1) ? &ARMUndefined : &ARMSingleDataTransfer;
+	if ((op & 0xE0) == 0x80)
+		return &ARMBlockDataTransfer;
+	if ((op & 0xE0) == 0xA0)
+		return &ARMBranch;
+
+	if ((op & 0xF0) == 0xE0 && (lo & 1))
+	{
+		if constexpr (Version == ARMVersion::ARMv5TE)
+			return &ARMCoprocessorTransfer;
+		return &ARMUndefined;
+	}
+
+	if ((op & 0xF0) == 0xF0)
+		return &ARMSoftwareInterrupt;
+
+	return &ARMUndefined;
+}
+
+template <ARMVersion Version, class BusInterface>
+constexpr std::array<typename ARMCore<Version, BusInterface>::ARMHandler, 4096> ARMCore<Version, BusInterface>::GenerateARMTable()
+{
+	std::array<ARMHandler, 4096> table{};
+
+	for (uint32_t index = 0; index < 4096; index++)
+		table[index] = DecodeARM(((index & 0xFF0) << 16) | ((index & 0xF) << 4));
+
+	return table;
+}
+
+template <ARMVersion Version, class BusInterface>
+constexpr std::array<typename ARMCore<Version, BusInterface>::ThumbHandler, 1024> ARMCore<Version, BusInterface>::GenerateThumbTable()
+{
+	using Thumb::Format;
+
+	Thumb::FormatHandlers<ThumbHandler> handlers{};
+
+	handlers[(size_t)Format::MoveShifted] = &ThumbMoveShifted;
+	handlers[(size_t)Format::AddSubtract] = &ThumbAddSubtract;
+	handlers[(size_t)Format::MovCmpAddSubImm] = &ThumbMovCmpAddSubImm;
+	handlers[(size_t)Format::ALUOperation] = &ThumbALUOperation;
+	handlers[(size_t)Format::HiRegisterOperation] = &ThumbHiRegisterOperation;
+	handlers[(size_t)Format::PCRelativeLoad] = &ThumbPCRelativeLoad;
+	handlers[(size_t)Format::LoadStoreRegister] = &ThumbLoadStoreRegister;
+	handlers[(size_t)Format::LoadStoreSignExtended] = &ThumbLoadStoreSignExtended;
+	handlers[(size_t)Format::LoadStoreImmediate] = &ThumbLoadStoreImmediate;
+	handlers[(size_t)Format::LoadStoreHalfword] = &ThumbLoadStoreHalfword;
+	handlers[(size_t)Format::SPRelativeLoadStore] = &ThumbSPRelativeLoadStore;
+	handlers[(size_t)Format::LoadAddress] = &ThumbLoadAddress;
+	handlers[(size_t)Format::AddOffsetToSP] = &ThumbAddOffsetToSP;
+	handlers[(size_t)Format::PushPop] = &ThumbPushPop;
+	handlers[(size_t)Format::LoadStoreMultiple] = &ThumbLoadStoreMultiple;
+	handlers[(size_t)Format::ConditionalBranch] = &ThumbConditionalBranch;
+	handlers[(size_t)Format::SoftwareInterrupt] = &ThumbSoftwareInterrupt;
+	handlers[(size_t)Format::UnconditionalBranch] = &ThumbUnconditionalBranch;
+	handlers[(size_t)Format::LongBranchLink] = &ThumbLongBranchLink;
+	handlers[(size_t)Format::Undefined] = &ThumbUndefined;
+
+	if constexpr (Version == ARMVersion::ARMv5TE)
+		handlers[(size_t)Format::BranchLinkExchange] = &ThumbBranchLinkExchange;
+	else
+		handlers[(size_t)Format::BranchLinkExchange] = &ThumbUndefined;
+
+	return Thumb::GenerateTable(handlers);
+}
+
+template <ARMVersion Version, class BusInterface>
+constinit const std::array<typename ARMCore<Version, BusInterface>::ARMHandler, 4096> ARMCore<Version, BusInterface>::arm_table = GenerateARMTable();
+
+template <ARMVersion Version, class BusInterface>
+constinit const std::array<typename ARMCore<Version, BusInterface>::ThumbHandler, 1024> ARMCore<Version, BusInterface>::thumb_table = GenerateThumbTable();
+
+// Mirrors of RAM share pages, so a write through one mirror, or by the other CPU, drops code run through another
+template <ARMVersion Version, class BusInterface>
+uint32_t ARMCore<Version, BusInterface>::CodePage(uint32_t addr)
+{
+	return Bus::CodeAddress(Version == ARMVersion::ARMv5TE, addr) >> 12;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::InvalidateCode(uint32_t addr)
+{
+	InvalidateCodePage(CodePage(addr));
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::InvalidateCodePage(uint32_t page)
+{
+	if (!code_pages[page])
+		return;
+
+	for (uint32_t key : page_blocks[page])
+		blocks.erase(key);
+
+	page_blocks.erase(page);
+	code_pages[page] = false;
+	code_invalidated = 1;
+}
+
+// For when the guest flushes its instruction cache, which covers writes the page tracking can't see
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::InvalidateAllCode()
+{
+	blocks.clear();
+	page_blocks.clear();
+	code_pages.reset();
+	code_invalidated = 1;
+}
+
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::EndsBlock(uint32_t instr)
+{
+	switch ((instr >> 25) & 0x7)
+	{
+	case 0b000:
+	case 0b001:
+	case 0b010:
+	case 0b011:
+		// Anything writing r15, plus BX and BLX
+		return ((instr >> 12) & 0xF) == 15 || (instr & 0x0FFFFFD0) == 0x012FFF10;
+	case 0b100:
+		return (instr & (1 << 20)) && (instr & (1 << 15));
+	case 0b101:
+		return true;
+	default:
+		return ((instr >> 24) & 0xF) == 0xF;
+	}
+}
+
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::EndsThumbBlock(uint16_t instr)
+{
+	// Conditional branches and SWI
+	if ((instr >> 12) == 0b1101)
+		return true;
+	// B, and the second half of BL and BLX
+	if ((instr >> 11) == 0b11100 || (instr >> 11) == 0b11101 || (instr >> 11) == 0b11111)
+		return true;
+	// POP {pc}
+	if ((instr & 0xFF00) == 0xBD00)
+		return true;
+	// BX, BLX and hi register operations on r15
+	if ((instr >> 10) == 0b010001)
+		return ((instr >> 8) & 3) == 3 || (instr & 0x87) == 0x87;
+	return false;
+}
+
+template <ARMVersion Version, class BusInterface>
+typename ARMCore<Version, BusInterface>::Block& ARMCore<Version, BusInterface>::CompileBlock(uint32_t addr, uint32_t key)
+{
+	Block& block = blocks[key];
+	uint32_t page = CodePage(addr);
+	bool thumb = key & 1;
+
+	for (int i = 0; i < max_block_size; i++)
+	{
+		MicroOp op;
+		bool end;
+
+		if (thumb)
+		{
+			uint16_t instr = BusInterface::Read16(addr);
+			op.thumb = thumb_table[Thumb::TableIndex(instr)];
+			op.instr = instr;
+			op.cond = 0xE;
+			end = EndsThumbBlock(instr) || op.thumb == &ThumbUndefined;
+			addr += 2;
+		}
+		else
+		{
+			uint32_t instr = BusInterface::Read32(addr);
+			op.arm = arm_table[((instr >> 16) & 0xFF0) | ((instr >> 4) & 0xF)];
+			op.instr = instr;
+			op.cond = instr >> 28;
+
+			// ARMv5 reuses the NV condition for a handful of unconditional instructions
+			if constexpr (Version == ARMVersion::ARMv5TE)
+			{
+				if (op.cond == 0xF)
+				{
+					if (((instr >> 25) & 0x7) == 0b101)
+						op.arm = &ARMBranchLinkExchangeImm;
+					else if ((instr & 0x0D70F000) == 0x0550F000)
+						op.arm = &ARMPreload;
+					else
+						op.arm = &ARMUndefined;
+					op.cond = 0xE;
+				}
+			}
+
+			end = EndsBlock(instr) || op.arm == &ARMUndefined;
+			addr += 4;
+		}
+
+		block.ops.push_back(op);
+		block.may_idle &= IsSideEffectFree(op, thumb);
+
+		if (end || CodePage(addr) != page)
+			break;
+	}
+
+	page_blocks[page].push_back(key);
+	code_pages[page] = true;
+
+	return block;
+}
+
+// Runs one block and returns the number of instructions executed
+template <ARMVersion Version, class BusInterface>
+int ARMCore<Version, BusInterface>::RunBlock()
+{
+	if (single_step)
+	{
+		can_disassemble = true;
+		getc(stdin);
+		Dump();
+	}
+
+	// The next instruction sits at PC-8 (PC-4 in THUMB), LR has to point one instruction past it
+	if (!cpsr.flags.i && BusInterface::IsInterruptAvailable())
+		RaiseException(MODE_IRQ, 0x18, cpsr.flags.t ? GetReg(15) : GetReg(15) - 4);
+
+	bool thumb = cpsr.flags.t;
+	uint32_t addr = GetReg(15) - (thumb ? 4 : 8);
+	uint32_t key = addr | thumb;
+
+	auto it = blocks.find(key);
+	Block& block = it != blocks.end() ? it->second : CompileBlock(addr, key);
+
+	// A write to its own page can free the block while it runs
+	bool may_idle = block.may_idle;
+	code_invalidated = 0;
+
+	// The interpreter below is kept for tracing
+	if (JIT::enabled && !can_disassemble)
+	{
+		if (!block.native || block.native_generation != JIT::generation)
+			CompileNative(block, GetReg(15));
+		int executed = block.native();
+		CheckIdleLoop(may_idle, key, addr);
+		return executed;
+	}
+
+	uint32_t expected = GetReg(15);
+	int executed = 0;
+
+	for (const MicroOp& op : block.ops)
+	{
+		executed++;
+
+		if (thumb)
+		{
+			if (can_disassemble)
+				printf("[%s] 0x%08x (0x%04x): ", name, expected - 4, op.instr);
+
+			op.thumb(op.instr);
+			expected += 2;
+		}
+		else
+		{
+			if (can_disassemble)
+				printf("[%s] 0x%08x (0x%08x): ", name, expected - 8, op.instr);
+
+			if (op.cond == 0xE || CondPassed(op.cond))
+				op.arm(op.instr);
+			else
+			{
+				if (can_disassemble)
+					printf("condition failed\n");
+				GetReg(15) += 4;
+			}
+			expected += 4;
+		}
+
+		// Leave on a taken branch, or if the block itself was just overwritten
+		if (GetReg(15) != expected || code_invalidated)
+			break;
+	}
+
+	CheckIdleLoop(may_idle, key, addr);
+	return executed;
+}
+
+// Loads, ALU ops and branches. Anything else could be what ends the loop
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::IsSideEffectFree(const MicroOp& op, bool thumb)
+{
+	bool load = op.instr & (1 << (thumb ? 11 : 20));
+
+	if (thumb)
+	{
+		if (op.thumb == &ThumbLoadStoreSignExtended)
+			return (op.instr >> 10) & 3;
+		if (op.thumb == &ThumbLoadStoreRegister || op.thumb == &ThumbLoadStoreImmediate
+			|| op.thumb == &ThumbLoadStoreHalfword || op.thumb == &ThumbSPRelativeLoadStore)
+			return load;
+
+		return op.thumb == &ThumbMoveShifted || op.thumb == &ThumbAddSubtract || op.thumb == &ThumbMovCmpAddSubImm
+			|| op.thumb == &ThumbALUOperation || op.thumb == &ThumbHiRegisterOperation || op.thumb == &ThumbPCRelativeLoad
+			|| op.thumb == &ThumbConditionalBranch || op.thumb == &ThumbUnconditionalBranch;
+	}
+
+	// Writing r15 from data processing can restore CPSR
+	if (op.arm == &ARMDataProcessing)
+		return ((op.instr >> 12) & 0xF) != 15;
+	if (op.arm == &ARMSingleDataTransfer || op.arm == &ARMHalfwordTransfer)
+		return load;
+
+	return op.arm == &ARMBranch || op.arm == &ARMBranchExchange || op.arm == &ARMPSRTransferMRS;
+}
+
+// A block that branches back to itself without storing anything, and ends up with the same
+// registers and flags twice in a row, reads the same values every time round. Nothing changes
+// until an event does, so the CPU can stop there
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::CheckIdleLoop(bool may_idle, uint32_t key, uint32_t pc)
+{
+	if (!may_idle || code_invalidated || GetReg(15) - (cpsr.flags.t ? 4 : 8) != pc || cpsr.flags.t != (key & 1))
+	{
+		idle_key = 2;
+		return;
+	}
+
+	uint32_t state[16];
+	for (int i = 0; i < 15; i++)
+		state[i] = GetReg(i);
+	SyncFlags();
+	state[15] = cpsr.val;
+
+	idle = idle_key == key && !memcmp(state, idle_state, sizeof(state));
+	idle_key = key;
+	memcpy(idle_state, state, sizeof(state));
+}
+
+#if defined(__x86_64__)
+
+// Data processing without shifts or r15, THUMB formats 1-4, the hi register ADD, CMP and MOV,
+// and branches to a fixed target don't need the interpreter at all
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::IsNative(const MicroOp& op, bool thumb)
+{
+	uint32_t instr = op.instr;
+
+	if (thumb)
+	{
+		if (op.thumb == &ThumbMoveShifted || op.thumb == &ThumbAddSubtract || op.thumb == &ThumbMovCmpAddSubImm
+			|| op.thumb == &ThumbUnconditionalBranch)
+			return true;
+		// Shifts by a register stay in the interpreter
+		if (op.thumb == &ThumbALUOperation)
+			return !((0x009C >> ((instr >> 6) & 0xF)) & 1);
+		if (op.thumb == &ThumbHiRegisterOperation)
+			return ((instr >> 8) & 3) != 3 && ((instr >> 3) & 0xF) != 15 && ((instr & 7) | ((instr >> 4) & 8)) != 15;
+		if (op.thumb == &ThumbConditionalBranch)
+			return ((instr >> 8) & 0xF) < 0xE;
+		return false;
+	}
+
+	if (op.arm == &ARMBranch)
+		return true;
+	if (op.arm != &ARMDataProcessing)
+		return false;
+
+	uint8_t opcode = (instr >> 21) & 0xF;
+	bool s = (instr >> 20) & 1;
+	uint8_t rn = (instr >> 16) & 0xF;
+	uint8_t rd = (instr >> 12) & 0xF;
+	uint8_t rm = instr & 0xF;
+	bool imm = (instr >> 25) & 1;
+	bool uses_rn = opcode != 0xD && opcode != 0xF;
+
+	// Everything but RSB and RSC with S. Without it, only ops that don't read C
+	uint16_t native_opcodes = s ? 0xFF77 : 0xF01F;
+
+	return ((native_opcodes >> opcode) & 1) && rd != 15 && !(uses_rn && rn == 15)
+		&& (imm || (((instr >> 4) & 0xFF) == 0 && rm != 15));
+}
+
+// Flag-setting ops leave the flags in Logic form, with C and V taken from the host. Once the
+// block knows they're in that form, ops that keep some of them and checks on a single flag
+// don't need a call
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::EmitNative(const MicroOp& op, bool thumb, uint32_t pc, bool& logic_flags)
+{
+	static constexpr JIT::ALUOp alu_ops[16] =
+	{
+		JIT::ALUOp::And, JIT::ALUOp::Xor, JIT::ALUOp::Sub, JIT::ALUOp::Rsb,
+		JIT::ALUOp::Add, JIT::ALUOp::Adc, JIT::ALUOp::Sbc, JIT::ALUOp::Add,
+		JIT::ALUOp::And, JIT::ALUOp::Xor, JIT::ALUOp::Sub, JIT::ALUOp::Add,
+		JIT::ALUOp::Or, JIT::ALUOp::Mov, JIT::ALUOp::Bic, JIT::ALUOp::Mvn
+	};
+
+	static constexpr JIT::ALUOp thumb_alu_ops[16] =
+	{
+		JIT::ALUOp::And, JIT::ALUOp::Xor, JIT::ALUOp::Mov, JIT::ALUOp::Mov,
+		JIT::ALUOp::Mov, JIT::ALUOp::Adc, JIT::ALUOp::Sbc, JIT::ALUOp::Mov,
+		JIT::ALUOp::And, JIT::ALUOp::Sub, JIT::ALUOp::Sub, JIT::ALUOp::Add,
+		JIT::ALUOp::Or, JIT::ALUOp::Mul, JIT::ALUOp::Bic, JIT::ALUOp::Mvn
+	};
+
+	static constexpr JIT::ShiftOp shift_ops[3] = {JIT::ShiftOp::Lsl, JIT::ShiftOp::Lsr, JIT::ShiftOp::Asr};
+
+	uint32_t instr = op.instr;
+
+	auto keep_flags = [&]()
+	{
+		if (!logic_flags)
+			JIT::EmitCall((const void*)&PrepareLogicFlags, 0);
+		logic_flags = true;
+	};
+
+	// result in eax, and C and V from the host flags unless the op is a logical one
+	auto set_flags = [&](bool arithmetic, bool borrow)
+	{
+		JIT::EmitStoreResult(&flag_result);
+		if (arithmetic)
+		{
+			JIT::EmitStoreCarry(&flag_carry, borrow);
+			JIT::EmitStoreOverflow(&flag_v);
+		}
+		if (!logic_flags)
+			JIT::EmitStoreByte(&flag_op, (uint8_t)FlagOp::Logic);
+		logic_flags = true;
+	};
+
+	if (!thumb)
+	{
+		if (op.arm == &ARMBranch)
+		{
+			if ((instr >> 24) & 1)
+				JIT::EmitStoreRegImm(14, pc - 4);
+			JIT::EmitStoreRegImm(15, pc + ((int32_t)(instr << 8) >> 6) + 8);
+			return;
+		}
+
+		uint8_t opcode = (instr >> 21) & 0xF;
+		bool s = (instr >> 20) & 1;
+		bool imm = (instr >> 25) & 1;
+		uint8_t rotate = ((instr >> 8) & 0xF) * 2;
+		uint32_t op2 = std::rotr(instr & 0xFF, rotate);
+		bool arithmetic = !((0xF303 >> opcode) & 1);
+
+		if (s && (!arithmetic || opcode == 0x5 || opcode == 0x6))
+			keep_flags();
+
+		if (opcode != 0xD && opcode != 0xF)
+			JIT::EmitLoadReg(0, (instr >> 16) & 0xF);
+		if (!imm)
+			JIT::EmitLoadReg(1, instr & 0xF);
+		if (opcode == 0x5 || opcode == 0x6)
+			JIT::EmitLoadCarry(&flag_carry, opcode == 0x6);
+
+		if (imm)
+			JIT::EmitALUImm(alu_ops[opcode], op2);
+		else
+			JIT::EmitALUReg(alu_ops[opcode]);
+
+		// TST, TEQ, CMP and CMN only update the flags
+		if ((opcode & 0xC) != 0x8)
+			JIT::EmitStoreReg((instr >> 12) & 0xF);
+
+		if (s)
+		{
+			set_flags(arithmetic, opcode == 0x2 || opcode == 0x6 || opcode == 0xA);
+			// A rotated immediate is the shifter's carry out
+			if (!arithmetic && imm && rotate)
+				JIT::EmitStoreByte(&flag_carry, op2 >> 31);
+		}
+		return;
+	}
+
+	if (op.thumb == &ThumbMoveShifted)
+	{
+		uint8_t shift = (instr >> 11) & 0x3;
+		uint8_t offset5 = (instr >> 6) & 0x1F;
+
+		keep_flags();
+		JIT::EmitLoadReg(0, (instr >> 3) & 0x7);
+		if (shift || offset5)
+			JIT::EmitShiftImm(shift_ops[shift], offset5 ? offset5 : 32);
+		JIT::EmitStoreReg(instr & 0x7);
+		JIT::EmitStoreResult(&flag_result);
+		if (shift || offset5)
+			JIT::EmitStoreCarry(&flag_carry, false);
+	}
+	else if (op.thumb == &ThumbAddSubtract)
+	{
+		bool sub = (instr >> 9) & 1;
+		uint8_t rn = (instr >> 6) & 0x7;
+
+		JIT::EmitLoadReg(0, (instr >> 3) & 0x7);
+		if ((instr >> 10) & 1)
+			JIT::EmitALUImm(sub ? JIT::ALUOp::Sub : JIT::ALUOp::Add, rn);
+		else
+		{
+			JIT::EmitLoadReg(1, rn);
+			JIT::EmitALUReg(sub ? JIT::ALUOp::Sub : JIT::ALUOp::Add);
+		}
+		JIT::EmitStoreReg(instr & 0x7);
+		set_flags(true, sub);
+	}
+	else if (op.thumb == &ThumbMovCmpAddSubImm)
+	{
+		static constexpr JIT::ALUOp ops[4] = {JIT::ALUOp::Mov, JIT::ALUOp::Sub, JIT::ALUOp::Add, JIT::ALUOp::Sub};
+		uint8_t opcode = (instr >> 11) & 0x3;
+		uint8_t rd = (instr >> 8) & 0x7;
+
+		if (opcode == 0)
+			keep_flags();
+		else
+			JIT::EmitLoadReg(0, rd);
+		JIT::EmitALUImm(ops[opcode], instr & 0xFF);
+		if (opcode != 1)
+			JIT::EmitStoreReg(rd);
+		set_flags(opcode != 0, opcode != 2);
+	}
+	else if (op.thumb == &ThumbALUOperation)
+	{
+		uint8_t opcode = (instr >> 6) & 0xF;
+		uint8_t rd = instr & 0x7;
+		// ADC, SBC, NEG, CMP and CMN set all four flags
+		bool arithmetic = (0x0E60 >> opcode) & 1;
+
+		if (!arithmetic || opcode == 0x5 || opcode == 0x6)
+			keep_flags();
+
+		if (opcode == 0x9)
+			JIT::EmitALUImm(JIT::ALUOp::Mov, 0);
+		else
+			JIT::EmitLoadReg(0, rd);
+		JIT::EmitLoadReg(1, (instr >> 3) & 0x7);
+		if (opcode == 0x5 || opcode == 0x6)
+			JIT::EmitLoadCarry(&flag_carry, opcode == 0x6);
+		JIT::EmitALUReg(thumb_alu_ops[opcode]);
+
+		if (opcode != 0x8 && opcode != 0xA && opcode != 0xB)
+			JIT::EmitStoreReg(rd);
+		set_flags(arithmetic, opcode == 0x6 || opcode == 0x9 || opcode == 0xA);
+	}
+	else if (op.thumb == &ThumbHiRegisterOperation)
+	{
+		uint8_t opcode = (instr >> 8) & 0x3;
+		uint8_t rd = (instr & 0x7) | ((instr >> 4) & 8);
+
+		if (opcode != 2)
+			JIT::EmitLoadReg(0, rd);
+		JIT::EmitLoadReg(1, (instr >> 3) & 0xF);
+		JIT::EmitALUReg(opcode == 0 ? JIT::ALUOp::Add : (opcode == 1 ? JIT::ALUOp::Sub : JIT::ALUOp::Mov));
+
+		if (opcode == 1)
+			set_flags(true, true);
+		else
+			JIT::EmitStoreReg(rd);
+	}
+	else if (op.thumb == &ThumbConditionalBranch)
+		JIT::EmitStoreRegImm(15, pc + (int8_t)(instr & 0xFF) * 2 + 4);
+	else
+		JIT::EmitStoreRegImm(15, pc + ((int32_t)(instr << 21) >> 20) + 4);
+}
+
+// Native ops never read r15, so it's only brought up to date before a call or an exit
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::CompileNative(Block& block, uint32_t pc)
+{
+	bool thumb = cpsr.flags.t;
+	uint8_t step = thumb ? 2 : 4;
+	uint32_t expected = pc;
+	uint32_t synced_pc = pc;
+	bool logic_flags = false;
+	int executed = 0;
+
+	JIT::BeginBlock();
+	JIT::EmitPrologue(&r[15]);
+
+	for (const MicroOp& op : block.ops)
+	{
+		executed++;
+
+		bool native = IsNative(op, thumb);
+		bool branch = native && (thumb ? op.thumb == &ThumbConditionalBranch || op.thumb == &ThumbUnconditionalBranch : op.arm == &ARMBranch);
+		uint8_t cond = native && thumb && op.thumb == &ThumbConditionalBranch ? (op.instr >> 8) & 0xF : op.cond;
+
+		if (!native && synced_pc != expected)
+		{
+			JIT::EmitAdvancePC(expected - synced_pc);
+			synced_pc = expected;
+		}
+
+		uint8_t* skip = nullptr;
+		bool known_before = logic_flags;
+		if (cond != 0xE)
+		{
+			// EQ/NE, CS/CC, MI/PL and VS/VC each look at one flag
+			static constexpr JIT::SkipIf pass_if_set[4] = {JIT::SkipIf::NonZero, JIT::SkipIf::Zero, JIT::SkipIf::NotNegative, JIT::SkipIf::Zero};
+			static constexpr JIT::SkipIf pass_if_clear[4] = {JIT::SkipIf::Zero, JIT::SkipIf::NonZero, JIT::SkipIf::Negative, JIT::SkipIf::NonZero};
+			const void* flags[4] = {&flag_result, &flag_carry, &flag_result, &flag_v};
+
+			if (logic_flags && cond < 8)
+				skip = JIT::EmitSkipIf(flags[cond >> 1], (cond >> 1) & 1 ? 1 : 4, (cond & 1) ? pass_if_clear[cond >> 1] : pass_if_set[cond >> 1]);
+			else
+				skip = JIT::EmitConditionCheck((const void*)&CondPassed, cond);
+		}
+
+		if (native)
+			EmitNative(op, thumb, expected, logic_flags);
+		else
+		{
+			if (thumb)
+				JIT::EmitCall((const void*)op.thumb, op.instr);
+			else
+				JIT::EmitCall((const void*)op.arm, op.instr);
+			logic_flags = false;
+		}
+
+		// A skipped native op leaves r15 for later, the rest have to move it on themselves
+		if (skip)
+		{
+			if (native && !branch)
+				JIT::PatchJump(skip);
+			else
+			{
+				uint8_t* done = JIT::EmitJump();
+				JIT::PatchJump(skip);
+				if (branch)
+					JIT::EmitStoreRegImm(15, expected + step);
+				else
+					JIT::EmitAdvancePC(step);
+				JIT::PatchJump(done);
+			}
+			logic_flags &= known_before;
+		}
+
+		expected += step;
+
+		if (!native || branch)
+		{
+			synced_pc = expected;
+			JIT::EmitExitUnlessPC(expected, executed);
+			if (!native && !IsSideEffectFree(op, thumb))
+				JIT::EmitExitUnlessEqual(&code_invalidated, 0, executed);
+		}
+	}
+
+	if (synced_pc != expected)
+		JIT::EmitAdvancePC(expected - synced_pc);
+	JIT::EmitExit(executed);
+
+	block.native = JIT::EndBlock();
+	block.native_generation = JIT::generation;
+}
+
+#else
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::CompileNative(Block& block, uint32_t pc)
+{
+}
+
+#endif
+
+// Executes whole blocks, so a slice can overrun by up to one block. The overrun is paid back
+// on the next call
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::Run(int cycles)
+{
+	cycles_left += cycles;
+	idle = false;
+
+	if (halted)
+	{
+		if (!BusInterface::IsInterruptPending())
+		{
+			cycles_left = 0;
+			return;
+		}
+		halted = false;
+	}
+
+	while (cycles_left > 0)
+	{
+		cycles_left -= RunBlock();
+
+		// Whatever ends the wait happens in an event, which can't run before the slice is over
+		if (halted || idle)
+		{
+			cycles_left = 0;
+			return;
+		}
+	}
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::Halt()
+{
+	halted = true;
+	// Leave the running block straight after the instruction that halted
+	code_invalidated = 1;
+}
+
+template <ARMVersion Version, class BusInterface>
+bool ARMCore<Version, BusInterface>::IsIdle()
+{
+	return halted || idle;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::Dump()
+{
+	SyncFlags();
+	for (int i = 0; i < 16; i++)
+		printf("r%d\t->\t0x%08x\n", i, GetReg(i));
+	printf("[%s%s%s%s%s] mode 0x%02x\n", cpsr.flags.t ? "t" : ".", cpsr.flags.n ? "n" : ".", cpsr.flags.z ? "z" : ".", cpsr.flags.c ? "c" : ".", cpsr.flags.v ? "v" : ".", cpsr.flags.mode);
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMDataProcessing(uint32_t instr)
+{
+	bool i = (instr >> 25) & 1;
+	uint8_t opcode = (instr >> 21) & 0xF;
+	bool s = (instr >> 20) & 1;
+	uint8_t rn = (instr >> 16) & 0xF;
+	uint8_t rd = (instr >> 12) & 0xF;
+
+	uint32_t op1 = GetReg(rn);
+	uint32_t op2;
+	bool carry = Carry();
+
+	if (i)
+	{
+		uint8_t rotate = ((instr >> 8) & 0xF) * 2;
+		op2 = std::rotr(instr & 0xFF, rotate);
+		if (rotate)
+			carry = op2 >> 31;
+	}
+	else
+	{
+		uint8_t rm = instr & 0xF;
+		uint8_t type = (instr >> 5) & 3;
+		uint32_t value = GetReg(rm);
+
+		if ((instr >> 4) & 1)
+		{
+			// The extra cycle for a register shift means PC reads 12 ahead
+			if (rn == 15)
+				op1 += 4;
+			if (rm == 15)
+				value += 4;
+			op2 = Shift(value, type, GetReg((instr >> 8) & 0xF) & 0xFF, false, carry);
+		}
+		else
+			op2 = Shift(value, type, (instr >> 7) & 0x1F, true, carry);
+	}
+
+	uint32_t result;
+
+	switch (opcode)
+	{
+	case 0x0:
+	case 0x8:
+		result = op1 & op2;
+		break;
+	case 0x1:
+	case 0x9:
+		result = op1 ^ op2;
+		break;
+	case 0x2:
+		result = Sub(op1, op2, true, s);
+		break;
+	case 0x3:
+		result = Sub(op2, op1, true, s);
+		break;
+	case 0x4:
+		result = Add(op1, op2, false, s);
+		break;
+	case 0x5:
+		result = Add(op1, op2, Carry(), s);
+		break;
+	case 0x6:
+		result = Sub(op1, op2, Carry(), s);
+		break;
+	case 0x7:
+		result = Sub(op2, op1, Carry(), s);
+		break;
+	case 0xA:
+		result = Sub(op1, op2, true, true);
+		break;
+	case 0xB:
+		result = Add(op1, op2, false, true);
+		break;
+	case 0xC:
+		result = op1 | op2;
+		break;
+	case 0xD:
+		result = op2;
+		break;
+	case 0xE:
+		result = op1 & ~op2;
+		break;
+	default:
+		result = ~op2;
+		break;
+	}
+
+	// Logical operations take C from the shifter instead of the ALU
+	if (s && ((0xF303 >> opcode) & 1))
+	{
+		SetLogicFlags(result, carry);
+	}
+
+	if (can_disassemble)
+		printf("%s%s r%d, r%d, #0x%08x\n", data_processing_names[opcode], s ? "s" : "", rd, rn, op2);
+
+	// TST, TEQ, CMP and CMN only update the flags
+	if ((opcode & 0xC) == 0x8)
+	{
+		GetReg(15) += 4;
+		return;
+	}
+
+	SetReg(rd, result);
+
+	if (rd == 15)
+	{
+		if (s)
+			RestoreCPSR();
+		FlushPipeline();
+	}
+	else
+		GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMPSRTransferMRS(uint32_t instr)
+{
+	bool r = (instr >> 22) & 1;
+	uint8_t rd = (instr >> 12) & 0xF;
+
+	if (can_disassemble)
+		printf("mrs r%d, %s\n", rd, r ? "spsr" : "cpsr");
+
+	SyncFlags();
+	SetReg(rd, (r && cur_spsr) ? cur_spsr->val : cpsr.val);
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMPSRTransferMSR(uint32_t instr)
+{
+	bool r = (instr >> 22) & 1;
+
+	uint32_t value;
+	if ((instr >> 25) & 1)
+		value = std::rotr(instr & 0xFF, ((instr >> 8) & 0xF) * 2);
+	else
+		value = GetReg(instr & 0xF);
+
+	uint32_t mask = 0;
+	if (instr & (1 << 16))
+		mask |= 0x000000FF;
+	if (instr & (1 << 17))
+		mask |= 0x0000FF00;
+	if (instr & (1 << 18))
+		mask |= 0x00FF0000;
+	if (instr & (1 << 19))
+		mask |= 0xFF000000;
+
+	if (can_disassemble)
+		printf("msr %s_%s%s%s%s, #0x%08x\n", r ? "spsr" : "cpsr", (mask & 0xFF000000) ? "f" : "", (mask & 0xFF0000) ? "s" : "", (mask & 0xFF00) ? "x" : "", (mask & 0xFF) ? "c" : "", value);
+
+	if (r)
+	{
+		if (cur_spsr)
+			cur_spsr->val = (cur_spsr->val & ~mask) | (value & mask);
+	}
+	else
+	{
+		// User mode can only change the condition flags
+		if (cpsr.flags.mode == MODE_USR)
+			mask &= 0xFF000000;
+
+		SyncFlags();
+		uint32_t new_cpsr = (cpsr.val & ~mask) | (value & mask);
+		SwitchMode(new_cpsr & 0x1F);
+		cpsr.val = new_cpsr;
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMBranchExchange(uint32_t instr)
+{
+	uint8_t rm = instr & 0xF;
+
+	if (can_disassemble)
+		printf("bx r%d\n", rm);
+
+	BranchExchange(GetReg(rm));
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMMultiply(uint32_t instr)
+{
+	bool a = (instr >> 21) & 1;
+	bool s = (instr >> 20) & 1;
+	uint8_t rd = (instr >> 16) & 0xF;
+	uint8_t rn = (instr >> 12) & 0xF;
+	uint8_t rs = (instr >> 8) & 0xF;
+	uint8_t rm = instr & 0xF;
+
+	uint32_t result = GetReg(rm) * GetReg(rs);
+	if (a)
+		result += GetReg(rn);
+
+	if (can_disassemble)
+		printf("%s%s r%d, r%d, r%d\n", a ? "mla" : "mul", s ? "s" : "", rd, rm, rs);
+
+	SetReg(rd, result);
+
+	if (s)
+		SetNZ(result);
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMMultiplyLong(uint32_t instr)
+{
+	bool sign = (instr >> 22) & 1;
+	bool a = (instr >> 21) & 1;
+	bool s = (instr >> 20) & 1;
+	uint8_t rdhi = (instr >> 16) & 0xF;
+	uint8_t rdlo = (instr >> 12) & 0xF;
+	uint8_t rs = (instr >> 8) & 0xF;
+	uint8_t rm = instr & 0xF;
+
+	uint64_t result;
+	if (sign)
+		result = (int64_t)(int32_t)GetReg(rm) * (int64_t)(int32_t)GetReg(rs);
+	else
+		result = (uint64_t)GetReg(rm) * GetReg(rs);
+
+	if (a)
+		result += ((uint64_t)GetReg(rdhi) << 32) | GetReg(rdlo);
+
+	if (can_disassemble)
+		printf("%c%s%s r%d, r%d, r%d, r%d\n", sign ? 's' : 'u', a ? "mlal" : "mull", s ? "s" : "", rdlo, rdhi, rm, rs);
+
+	SetReg(rdlo, result);
+	SetReg(rdhi, result >> 32);
+
+	// 64-bit N and Z don't fit the recorded result
+	if (s)
+	{
+		SyncFlags();
+		cpsr.flags.n = result >> 63;
+		cpsr.flags.z = result == 0;
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMSwap(uint32_t instr)
+{
+	bool b = (instr >> 22) & 1;
+	uint8_t rn = (instr >> 16) & 0xF;
+	uint8_t rd = (instr >> 12) & 0xF;
+	uint8_t rm = instr & 0xF;
+
+	uint32_t addr = GetReg(rn);
+
+	if (can_disassemble)
+		printf("swp%s r%d, r%d, [r%d]\n", b ? "b" : "", rd, rm, rn);
+
+	if (b)
+	{
+		uint8_t tmp = BusInterface::Read8(addr);
+		BusInterface::Write8(addr, GetReg(rm));
+		SetReg(rd, tmp);
+	}
+	else
+	{
+		uint32_t tmp = ReadRotated32(addr);
+		BusInterface::Write32(addr & ~3, GetReg(rm));
+		SetReg(rd, tmp);
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMHalfwordTransfer(uint32_t instr)
+{
+	bool p = (instr >> 24) & 1;
+	bool u = (instr >> 23) & 1;
+	bool imm = (instr >> 22) & 1;
+	bool w = (instr >> 21) & 1;
+	bool l = (instr >> 20) & 1;
+	uint8_t rn = (instr >> 16) & 0xF;
+	uint8_t rd = (instr >> 12) & 0xF;
+	uint8_t sh = (instr >> 5) & 3;
+
+	uint32_t offset = imm ? (((instr >> 4) & 0xF0) | (instr & 0xF)) : GetReg(instr & 0xF);
+
+	uint32_t base = GetReg(rn);
+	uint32_t offset_addr = u ? base + offset : base - offset;
+	uint32_t addr = p ? offset_addr : base;
+
+	if (can_disassemble)
+		printf("%s%s r%d, [r%d, #%s0x%x]%s\n", l ? "ldr" : "str", sh == 1 ? "h" : (sh == 2 ? "sb" : "sh"), rd, rn, u ? "" : "-", offset, (!p || w) ? "!" : "");
+
+	if (l)
+	{
+		uint32_t value;
+		if (sh == 1)
+			value = ReadRotated16(addr);
+		else if (sh == 2)
+			value = (int8_t)BusInterface::Read8(addr);
+		else
+			value = ReadSigned16(addr);
+
+		if (!p || w)
+			SetReg(rn, offset_addr);
+
+		SetReg(rd, value);
+
+		if (rd == 15)
+		{
+			FlushPipeline();
+			return;
+		}
+	}
+	else
+	{
+		uint32_t value = GetReg(rd);
+		if (rd == 15)
+			value += 4;
+
+		BusInterface::Write16(addr & ~1, value);
+
+		if (!p || w)
+			SetReg(rn, offset_addr);
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMSingleDataTransfer(uint32_t instr)
+{
+	bool reg_offset = (instr >> 25) & 1;
+	bool p = (instr >> 24) & 1;
+	bool u = (instr >> 23) & 1;
+	bool b = (instr >> 22) & 1;
+	bool w = (instr >> 21) & 1;
+	bool l = (instr >> 20) & 1;
+	uint8_t rn = (instr >> 16) & 0xF;
+	uint8_t rd = (instr >> 12) & 0xF;
+
+	uint32_t offset;
+	if (reg_offset)
+	{
+		bool carry = Carry();
+		offset = Shift(GetReg(instr & 0xF), (instr >> 5) & 3, (instr >> 7) & 0x1F, true, carry);
+	}
+	else
+		offset = instr & 0xFFF;
+
+	uint32_t base = GetReg(rn);
+	uint32_t offset_addr = u ? base + offset : base - offset;
+	uint32_t addr = p ? offset_addr : base;
+
+	if (can_disassemble)
+		printf("%s%s r%d, [r%d, #%s0x%x]%s\n", l ? "ldr" : "str", b ? "b" : "", rd, rn, u ? "" : "-", offset, (!p || w) ? "!" : "");
+
+	if (l)
+	{
+		uint32_t value = b ? BusInterface::Read8(addr) : ReadRotated32(addr);
+
+		if (!p || w)
+			SetReg(rn, offset_addr);
+
+		if (rd == 15)
+		{
+			// Only ARMv5 switches to THUMB on a load into PC
+			if constexpr (Version == ARMVersion::ARMv5TE)
+				BranchExchange(value);
+			else
+			{
+				SetReg(15, value);
+				FlushPipeline();
+			}
+			return;
+		}
+
+		SetReg(rd, value);
+	}
+	else
+	{
+		uint32_t value = GetReg(rd);
+		if (rd == 15)
+			value += 4;
+
+		if (b)
+			BusInterface::Write8(addr, value);
+		else
+			BusInterface::Write32(addr & ~3, value);
+
+		if (!p || w)
+			SetReg(rn, offset_addr);
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMBlockDataTransfer(uint32_t instr)
+{
+	bool p = (instr >> 24) & 1;
+	bool u = (instr >> 23) & 1;
+	bool s = (instr >> 22) & 1;
+	bool w = (instr >> 21) & 1;
+	bool l = (instr >> 20) & 1;
+	uint8_t rn = (instr >> 16) & 0xF;
+	uint16_t rlist = instr & 0xFFFF;
+
+	uint32_t base = GetReg(rn);
+
+	// An empty list transfers nothing here but still moves the base by 16 words
+	uint32_t size = rlist ? std::popcount(rlist) * 4 : 0x40;
+	uint32_t addr = u ? base : base - size;
+	if (p == u)
+		addr += 4;
+	uint32_t new_base = u ? base + size : base - size;
+
+	// S without a load of PC transfers the User mode registers instead of the current bank
+	bool user_bank = s && !(l && (rlist & 0x8000));
+	auto reg = [&](int i) -> uint32_t& { return user_bank ? UserReg(i) : GetReg(i); };
+
+	if (can_disassemble)
+		printf("%s%s%s r%d%s, {0x%04x}%s\n", l ? "ldm" : "stm", u ? "i" : "d", p ? "b" : "a", rn, w ? "!" : "", rlist, s ? "^" : "");
+
+	if (l)
+	{
+		if (w)
+			SetReg(rn, new_base);
+
+		for (int i = 0; i < 16; i++)
+		{
+			if (rlist & (1 << i))
+			{
+				reg(i) = BusInterface::Read32(addr & ~3);
+				addr += 4;
+			}
+		}
+
+		// The ARM9 keeps the written back base unless Rn is the last register loaded
+		if constexpr (Version == ARMVersion::ARMv5TE)
+		{
+			if (w && (rlist & (1 << rn)) && (rlist == (1 << rn) || (rlist >> (rn + 1))))
+				SetReg(rn, new_base);
+		}
+
+		if (rlist & 0x8000)
+		{
+			if (s)
+				RestoreCPSR();
+			else if constexpr (Version == ARMVersion::ARMv5TE)
+				cpsr.flags.t = GetReg(15) & 1;
+
+			FlushPipeline();
+			return;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			if (rlist & (1 << i))
+			{
+				uint32_t value = reg(i);
+				if (i == 15)
+					value += 4;
+
+				// The ARM7 stores the new base if Rn isn't the first register in the list
+				if constexpr (Version == ARMVersion::ARMv4T)
+				{
+					if (i == rn && w && (rlist & ((1 << i) - 1)))
+						value = new_base;
+				}
+
+				BusInterface::Write32(addr & ~3, value);
+				addr += 4;
+			}
+		}
+
+		if (w)
+			SetReg(rn, new_base);
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMBranch(uint32_t instr)
+{
+	bool link = (instr >> 24) & 1;
+	int32_t offset = (int32_t)(instr << 8) >> 6;
+
+	if (can_disassemble)
+		printf("b%s 0x%08x\n", link ? "l" : "", GetReg(15) + offset);
+
+	if (link)
+		SetReg(14, GetReg(15) - 4);
+
+	SetReg(15, GetReg(15) + offset);
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMSoftwareInterrupt(uint32_t instr)
+{
+	if (can_disassemble)
+		printf("swi #0x%06x\n", instr & 0xFFFFFF);
+
+	RaiseException(MODE_SVC, 0x08, GetReg(15) - 4);
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMUndefined(uint32_t instr)
+{
+	LOG_ERROR(CPU, "%s unknown instruction 0x%08x at 0x%08x\n", name, instr, GetReg(15) - 8);
+	exit(1);
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbMoveShifted(uint16_t instr)
+{
+	uint8_t op = (instr >> 11) & 0x3;
+	uint8_t offset5 = (instr >> 6) & 0x1F;
+	uint8_t rs = (instr >> 3) & 0x7;
+	uint8_t rd = instr & 0x7;
+
+	bool carry = Carry();
+	uint32_t result = Shift(GetReg(rs), op, offset5, true, carry);
+
+	if (can_disassemble)
+		printf("%s r%d, r%d, #%d\n", op == 0 ? "lsl" : (op == 1 ? "lsr" : "asr"), rd, rs, offset5);
+
+	SetReg(rd, result);
+	SetLogicFlags(result, carry);
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbAddSubtract(uint16_t instr)
+{
+	bool imm = (instr >> 10) & 1;
+	bool sub = (instr >> 9) & 1;
+	uint8_t rn = (instr >> 6) & 0x7;
+	uint8_t rs = (instr >> 3) & 0x7;
+	uint8_t rd = instr & 0x7;
+
+	uint32_t op2 = imm ? rn : GetReg(rn);
+
+	if (can_disassemble)
+		printf("%s r%d, r%d, %s%d\n", sub ? "sub" : "add", rd, rs, imm ? "#" : "r", rn);
+
+	SetReg(rd, sub ? Sub(GetReg(rs), op2, true, true) : Add(GetReg(rs), op2, false, true));
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbMovCmpAddSubImm(uint16_t instr)
+{
+	uint8_t op = (instr >> 11) & 0x3;
+	uint8_t rd = (instr >> 8) & 0x7;
+	uint8_t imm8 = instr & 0xFF;
+
+	const char* names[4] = {"mov", "cmp", "add", "sub"};
+
+	if (can_disassemble)
+		printf("%s r%d, #0x%02x\n", names[op], rd, imm8);
+
+	switch (op)
+	{
+	case 0:
+		SetReg(rd, imm8);
+		SetNZ(imm8);
+		break;
+	case 1:
+		Sub(GetReg(rd), imm8, true, true);
+		break;
+	case 2:
+		SetReg(rd, Add(GetReg(rd), imm8, false, true));
+		break;
+	case 3:
+		SetReg(rd, Sub(GetReg(rd), imm8, true, true));
+		break;
+	}
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbALUOperation(uint16_t instr)
+{
+	uint8_t op = (instr >> 6) & 0xF;
+	uint8_t rs = (instr >> 3) & 0x7;
+	uint8_t rd = instr & 0x7;
+
+	uint32_t a = GetReg(rd);
+	uint32_t b = GetReg(rs);
+	bool carry = Carry();
+
+	uint32_t result;
+
+	switch (op)
+	{
+	case 0x0:
+	case 0x8:
+		result = a & b;
+		break;
+	case 0x1:
+		result = a ^ b;
+		break;
+	case 0x2:
+		result = Shift(a, 0, b & 0xFF, false, carry);
+		break;
+	case 0x3:
+		result = Shift(a, 1, b & 0xFF, false, carry);
+		break;
+	case 0x4:
+		result = Shift(a, 2, b & 0xFF, false, carry);
+		break;
+	case 0x5:
+		result = Add(a, b, Carry(), true);
+		break;
+	case 0x6:
+		result = Sub(a, b, Carry(), true);
+		break;
+	case 0x7:
+		result = Shift(a, 3, b & 0xFF, false, carry);
+		break;
+	case 0x9:
+		result = Sub(0, b, true, true);
+		break;
+	case 0xA:
+		result = Sub(a, b, true, true);
+		break;
+	case 0xB:
+		result = Add(a, b, false, true);
+		break;
+	case 0xC:
+		result = a | b;
+		break;
+	case 0xD:
+		result = a * b;
+		break;
+	case 0xE:
+		result = a & ~b;
+		break;
+	default:
+		result = ~b;
+		break;
+	}
+
+	// ADC, SBC, NEG, CMP and CMN already set all four flags
+	if (!((0x0E60 >> op) & 1))
+	{
+		SetLogicFlags(result, carry);
+	}
+
+	if (can_disassemble)
+		printf("%s r%d, r%d\n", thumb_alu_names[op], rd, rs);
+
+	if (op != 0x8 && op != 0xA && op != 0xB)
+		SetReg(rd, result);
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbHiRegisterOperation(uint16_t instr)
+{
+	uint8_t op = (instr >> 8) & 0x3;
+	bool h1 = (instr >> 7) & 1;
+	uint8_t rs = (instr >> 3) & 0xF;
+	uint8_t rd = (instr & 0x7) | (h1 << 3);
+
+	switch (op)
+	{
+	case 0:
+		if (can_disassemble)
+			printf("add r%d, r%d\n", rd, rs);
+		SetReg(rd, GetReg(rd) + GetReg(rs));
+		break;
+	case 1:
+		if (can_disassemble)
+			printf("cmp r%d, r%d\n", rd, rs);
+		Sub(GetReg(rd), GetReg(rs), true, true);
+		break;
+	case 2:
+		if (can_disassemble)
+			printf("mov r%d, r%d\n", rd, rs);
+		SetReg(rd, GetReg(rs));
+		break;
+	case 3:
+	{
+		uint32_t target = GetReg(rs);
+
+		if constexpr (Version == ARMVersion::ARMv5TE)
+		{
+			if (h1)
+				SetReg(14, (GetReg(15) - 2) | 1);
+		}
+
+		if (can_disassemble)
+			printf("%s r%d\n", h1 ? "blx" : "bx", rs);
+
+		BranchExchange(target);
+		return;
+	}
+	}
+
+	if (rd == 15 && op != 1)
+		FlushPipeline();
+	else
+		GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbPCRelativeLoad(uint16_t instr)
+{
+	uint8_t rd = (instr >> 8) & 0x7;
+	uint32_t addr = (GetReg(15) & ~3) + (instr & 0xFF) * 4;
+
+	if (can_disassemble)
+		printf("ldr r%d, [0x%08x]\n", rd, addr);
+
+	SetReg(rd, BusInterface::Read32(addr));
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbLoadStoreRegister(uint16_t instr)
+{
+	bool l = (instr >> 11) & 1;
+	bool b = (instr >> 10) & 1;
+	uint8_t ro = (instr >> 6) & 0x7;
+	uint8_t rb = (instr >> 3) & 0x7;
+	uint8_t rd = instr & 0x7;
+
+	uint32_t addr = GetReg(rb) + GetReg(ro);
+
+	if (can_disassemble)
+		printf("%s%s r%d, [r%d, r%d]\n", l ? "ldr" : "str", b ? "b" : "", rd, rb, ro);
+
+	if (l)
+		SetReg(rd, b ? BusInterface::Read8(addr) : ReadRotated32(addr));
+	else if (b)
+		BusInterface::Write8(addr, GetReg(rd));
+	else
+		BusInterface::Write32(addr & ~3, GetReg(rd));
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbLoadStoreSignExtended(uint16_t instr)
+{
+	uint8_t op = (instr >> 10) & 0x3;
+	uint8_t ro = (instr >> 6) & 0x7;
+	uint8_t rb = (instr >> 3) & 0x7;
+	uint8_t rd = instr & 0x7;
+
+	uint32_t addr = GetReg(rb) + GetReg(ro);
+
+	const char* names[4] = {"strh", "ldrh", "ldsb", "ldsh"};
+
+	if (can_disassemble)
+		printf("%s r%d, [r%d, r%d]\n", names[op], rd, rb, ro);
+
+	switch (op)
+	{
+	case 0:
+		BusInterface::Write16(addr & ~1, GetReg(rd));
+		break;
+	case 1:
+		SetReg(rd, ReadRotated16(addr));
+		break;
+	case 2:
+		SetReg(rd, (int8_t)BusInterface::Read8(addr));
+		break;
+	case 3:
+		SetReg(rd, ReadSigned16(addr));
+		break;
+	}
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbLoadStoreImmediate(uint16_t instr)
+{
+	bool b = (instr >> 12) & 1;
+	bool l = (instr >> 11) & 1;
+	uint8_t offset5 = (instr >> 6) & 0x1F;
+	uint8_t rb = (instr >> 3) & 0x7;
+	uint8_t rd = instr & 0x7;
+
+	uint32_t addr = GetReg(rb) + (b ? offset5 : offset5 * 4);
+
+	if (can_disassemble)
+		printf("%s%s r%d, [r%d, #0x%x]\n", l ? "ldr" : "str", b ? "b" : "", rd, rb, b ? offset5 : offset5 * 4);
+
+	if (l)
+		SetReg(rd, b ? BusInterface::Read8(addr) : ReadRotated32(addr));
+	else if (b)
+		BusInterface::Write8(addr, GetReg(rd));
+	else
+		BusInterface::Write32(addr & ~3, GetReg(rd));
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbLoadStoreHalfword(uint16_t instr)
+{
+	bool l = (instr >> 11) & 1;
+	uint8_t offset5 = (instr >> 6) & 0x1F;
+	uint8_t rb = (instr >> 3) & 0x7;
+	uint8_t rd = instr & 0x7;
+
+	uint32_t addr = GetReg(rb) + offset5 * 2;
+
+	if (can_disassemble)
+		printf("%s r%d, [r%d, #0x%x]\n", l ? "ldrh" : "strh", rd, rb, offset5 * 2);
+
+	if (l)
+		SetReg(rd, ReadRotated16(addr));
+	else
+		BusInterface::Write16(addr & ~1, GetReg(rd));
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbSPRelativeLoadStore(uint16_t instr)
+{
+	bool l = (instr >> 11) & 1;
+	uint8_t rd = (instr >> 8) & 0x7;
+	uint32_t offset = (instr & 0xFF) * 4;
+
+	uint32_t addr = GetReg(13) + offset;
+
+	if (can_disassemble)
+		printf("%s r%d, [sp, #0x%x]\n", l ? "ldr" : "str", rd, offset);
+
+	if (l)
+		SetReg(rd, ReadRotated32(addr));
+	else
+		BusInterface::Write32(addr & ~3, GetReg(rd));
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbLoadAddress(uint16_t instr)
+{
+	bool sp = (instr >> 11) & 1;
+	uint8_t rd = (instr >> 8) & 0x7;
+	uint32_t offset = (instr & 0xFF) * 4;
+
+	if (can_disassemble)
+		printf("add r%d, %s, #0x%x\n", rd, sp ? "sp" : "pc", offset);
+
+	SetReg(rd, (sp ? GetReg(13) : GetReg(15) & ~3) + offset);
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbAddOffsetToSP(uint16_t instr)
+{
+	bool s = (instr >> 7) & 1;
+	uint32_t offset = (instr & 0x7F) * 4;
+
+	if (can_disassemble)
+		printf("add sp, #%s0x%x\n", s ? "-" : "", offset);
+
+	SetReg(13, s ? GetReg(13) - offset : GetReg(13) + offset);
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbPushPop(uint16_t instr)
+{
+	bool l = (instr >> 11) & 1;
+	bool r = (instr >> 8) & 1;
+	uint8_t rlist = instr & 0xFF;
+
+	if (can_disassemble)
+		printf("%s {0x%02x%s}\n", l ? "pop" : "push", rlist, r ? (l ? ", pc" : ", lr") : "");
+
+	if (l)
+	{
+		uint32_t addr = GetReg(13);
+
+		for (int i = 0; i < 8; i++)
+		{
+			if (rlist & (1 << i))
+			{
+				SetReg(i, BusInterface::Read32(addr & ~3));
+				addr += 4;
+			}
+		}
+
+		if (r)
+		{
+			uint32_t pc = BusInterface::Read32(addr & ~3);
+			SetReg(13, addr + 4);
+
+			// Only ARMv5 can return to ARM state with a POP
+			if constexpr (Version == ARMVersion::ARMv5TE)
+				BranchExchange(pc);
+			else
+			{
+				SetReg(15, pc);
+				FlushPipeline();
+			}
+			return;
+		}
+
+		SetReg(13, addr);
+	}
+	else
+	{
+		uint32_t addr = GetReg(13) - (std::popcount(rlist) + r) * 4;
+		SetReg(13, addr);
+
+		for (int i = 0; i < 8; i++)
+		{
+			if (rlist & (1 << i))
+			{
+				BusInterface::Write32(addr & ~3, GetReg(i));
+				addr += 4;
+			}
+		}
+
+		if (r)
+			BusInterface::Write32(addr & ~3, GetReg(14));
+	}
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbLoadStoreMultiple(uint16_t instr)
+{
+	bool l = (instr >> 11) & 1;
+	uint8_t rb = (instr >> 8) & 0x7;
+	uint8_t rlist = instr & 0xFF;
+
+	uint32_t addr = GetReg(rb);
+
+	if (can_disassemble)
+		printf("%s r%d!, {0x%02x}\n", l ? "ldmia" : "stmia", rb, rlist);
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (rlist & (1 << i))
+		{
+			if (l)
+				SetReg(i, BusInterface::Read32(addr & ~3));
+			else
+				BusInterface::Write32(addr & ~3, GetReg(i));
+			addr += 4;
+		}
+	}
+
+	// A load into the base register wins over the writeback
+	if (!l || !(rlist & (1 << rb)))
+		SetReg(rb, addr);
+
+	GetReg(15) += 2;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbConditionalBranch(uint16_t instr)
+{
+	uint8_t cond = (instr >> 8) & 0xF;
+	int32_t offset = (int8_t)(instr & 0xFF) * 2;
+
+	if (can_disassemble)
+		printf("b%x 0x%08x\n", cond, GetReg(15) + offset);
+
+	if (!CondPassed(cond))
+	{
+		GetReg(15) += 2;
+		return;
+	}
+
+	SetReg(15, GetReg(15) + offset);
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbSoftwareInterrupt(uint16_t instr)
+{
+	if (can_disassemble)
+		printf("swi #0x%02x\n", instr & 0xFF);
+
+	RaiseException(MODE_SVC, 0x08, GetReg(15) - 2);
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbUnconditionalBranch(uint16_t instr)
+{
+	int32_t offset = (int32_t)((uint32_t)instr << 21) >> 20;
+
+	if (can_disassemble)
+		printf("b 0x%08x\n", GetReg(15) + offset);
+
+	SetReg(15, GetReg(15) + offset);
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbLongBranchLink(uint16_t instr)
+{
+	uint32_t offset = instr & 0x7FF;
+
+	// The first half stashes the upper part of the offset in LR
+	if (!((instr >> 11) & 1))
+	{
+		SetReg(14, GetReg(15) + ((int32_t)(offset << 21) >> 9));
+		GetReg(15) += 2;
+		return;
+	}
+
+	uint32_t target = GetReg(14) + (offset << 1);
+	SetReg(14, (GetReg(15) - 2) | 1);
+
+	if (can_disassemble)
+		printf("bl 0x%08x\n", target);
+
+	SetReg(15, target);
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbUndefined(uint16_t instr)
+{
+	LOG_ERROR(CPU, "%s unknown THUMB instruction 0x%04x at 0x%08x\n", name, instr, GetReg(15) - 4);
+	exit(1);
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMBranchLinkExchange(uint32_t instr) requires (Version == ARMVersion::ARMv5TE)
+{
+	uint8_t rm = instr & 0xF;
+	uint32_t target = GetReg(rm);
+
+	if (can_disassemble)
+		printf("blx r%d\n", rm);
+
+	SetReg(14, GetReg(15) - 4);
+	BranchExchange(target);
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMBranchLinkExchangeImm(uint32_t instr) requires (Version == ARMVersion::ARMv5TE)
+{
+	int32_t offset = ((int32_t)(instr << 8) >> 6) | (((instr >> 24) & 1) << 1);
+
+	if (can_disassemble)
+		printf("blx 0x%08x\n", GetReg(15) + offset);
+
+	SetReg(14, GetReg(15) - 4);
+	SetReg(15, GetReg(15) + offset);
+	cpsr.flags.t = 1;
+	FlushPipeline();
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMPreload(uint32_t /*instr*/) requires (Version == ARMVersion::ARMv5TE)
+{
+	if (can_disassemble)
+		printf("pld\n");
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMCountLeadingZeros(uint32_t instr) requires (Version == ARMVersion::ARMv5TE)
+{
+	uint8_t rd = (instr >> 12) & 0xF;
+	uint8_t rm = instr & 0xF;
+
+	if (can_disassemble)
+		printf("clz r%d, r%d\n", rd, rm);
+
+	SetReg(rd, std::countl_zero(GetReg(rm)));
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMSaturatingArithmetic(uint32_t instr) requires (Version == ARMVersion::ARMv5TE)
+{
+	uint8_t op = (instr >> 21) & 0x3;
+	uint8_t rn = (instr >> 16) & 0xF;
+	uint8_t rd = (instr >> 12) & 0xF;
+	uint8_t rm = instr & 0xF;
+
+	const char* names[4] = {"qadd", "qsub", "qdadd", "qdsub"};
+
+	if (can_disassemble)
+		printf("%s r%d, r%d, r%d\n", names[op], rd, rm, rn);
+
+	int64_t a = (int32_t)GetReg(rm);
+	int64_t b = (int32_t)GetReg(rn);
+
+	// QDADD and QDSUB saturate the doubled operand before using it
+	if (op & 2)
+	{
+		b *= 2;
+		if (Saturate(b))
+			cpsr.flags.q = 1;
+	}
+
+	int64_t result = (op & 1) ? a - b : a + b;
+	if (Saturate(result))
+		cpsr.flags.q = 1;
+
+	SetReg(rd, result);
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMSignedMultiplyHalfword(uint32_t instr) requires (Version == ARMVersion::ARMv5TE)
+{
+	uint8_t op = (instr >> 21) & 0x3;
+	uint8_t rd = (instr >> 16) & 0xF;
+	uint8_t rn = (instr >> 12) & 0xF;
+	uint8_t rs = (instr >> 8) & 0xF;
+	uint8_t rm = instr & 0xF;
+	bool x = (instr >> 5) & 1;
+	bool y = (instr >> 6) & 1;
+
+	int32_t a = (int16_t)(GetReg(rm) >> (x ? 16 : 0));
+	int32_t b = (int16_t)(GetReg(rs) >> (y ? 16 : 0));
+
+	switch (op)
+	{
+	case 0:
+	{
+		if (can_disassemble)
+			printf("smla%c%c r%d, r%d, r%d, r%d\n", x ? 't' : 'b', y ? 't' : 'b', rd, rm, rs, rn);
+		int64_t result = (int64_t)(a * b) + (int32_t)GetReg(rn);
+		if (result != (int32_t)result)
+			cpsr.flags.q = 1;
+		SetReg(rd, result);
+		break;
+	}
+	case 1:
+	{
+		// SMLAWy/SMULWy use all of Rm and keep the top 32 bits of the 48-bit product
+		int64_t result = ((int64_t)(int32_t)GetReg(rm) * b) >> 16;
+		if (x)
+		{
+			if (can_disassemble)
+				printf("smulw%c r%d, r%d, r%d\n", y ? 't' : 'b', rd, rm, rs);
+		}
+		else
+		{
+			if (can_disassemble)
+				printf("smlaw%c r%d, r%d, r%d, r%d\n", y ? 't' : 'b', rd, rm, rs, rn);
+			result += (int32_t)GetReg(rn);
+			if (result != (int32_t)result)
+				cpsr.flags.q = 1;
+		}
+		SetReg(rd, result);
+		break;
+	}
+	case 2:
+	{
+		if (can_disassemble)
+			printf("smlal%c%c r%d, r%d, r%d, r%d\n", x ? 't' : 'b', y ? 't' : 'b', rn, rd, rm, rs);
+		uint64_t result = ((uint64_t)GetReg(rd) << 32) | GetReg(rn);
+		result += (int64_t)(a * b);
+		SetReg(rn, result);
+		SetReg(rd, result >> 32);
+		break;
+	}
+	case 3:
+		if (can_disassemble)
+			printf("smul%c%c r%d, r%d, r%d\n", x ? 't' : 'b', y ? 't' : 'b', rd, rm, rs);
+		SetReg(rd, a * b);
+		break;
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMDoublewordTransfer(uint32_t instr) requires (Version == ARMVersion::ARMv5TE)
+{
+	bool p = (instr >> 24) & 1;
+	bool u = (instr >> 23) & 1;
+	bool imm = (instr >> 22) & 1;
+	bool w = (instr >> 21) & 1;
+	uint8_t rn = (instr >> 16) & 0xF;
+	uint8_t rd = (instr >> 12) & 0xE;
+	bool store = (instr >> 5) & 1;
+
+	uint32_t offset = imm ? (((instr >> 4) & 0xF0) | (instr & 0xF)) : GetReg(instr & 0xF);
+
+	uint32_t base = GetReg(rn);
+	uint32_t offset_addr = u ? base + offset : base - offset;
+	uint32_t addr = p ? offset_addr : base;
+
+	if (can_disassemble)
+		printf("%s r%d, [r%d, #%s0x%x]%s\n", store ? "strd" : "ldrd", rd, rn, u ? "" : "-", offset, (!p || w) ? "!" : "");
+
+	if (store)
+	{
+		uint32_t high = GetReg(rd + 1);
+		if (rd + 1 == 15)
+			high += 4;
+
+		BusInterface::Write32(addr & ~3, GetReg(rd));
+		BusInterface::Write32((addr + 4) & ~3, high);
+
+		if (!p || w)
+			SetReg(rn, offset_addr);
+	}
+	else
+	{
+		uint32_t low = BusInterface::Read32(addr & ~3);
+		uint32_t high = BusInterface::Read32((addr + 4) & ~3);
+
+		if (!p || w)
+			SetReg(rn, offset_addr);
+
+		SetReg(rd, low);
+		SetReg(rd + 1, high);
+
+		if (rd + 1 == 15)
+		{
+			FlushPipeline();
+			return;
+		}
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ARMCoprocessorTransfer(uint32_t instr) requires (Version == ARMVersion::ARMv5TE)
+{
+	bool l = (instr >> 20) & 1;
+
+	uint8_t crn = (instr >> 16) & 0xF;
+	uint8_t rd = (instr >> 12) & 0xF;
+	uint8_t cp_num = (instr >> 8) & 0xF;
+	uint8_t cp = (instr >> 5) & 0x7;
+	uint8_t crm = instr & 0xF;
+
+	// CP15 is the only coprocessor wired up on the ARM9
+	if (cp_num != 15)
+	{
+		ARMUndefined(instr);
+		return;
+	}
+
+	if (l)
+	{
+		if (can_disassemble)
+			printf("mrc p15, #0, r%d, c%d, c%d, #%d\n", rd, crn, crm, cp);
+		SetReg(rd, BusInterface::ReadCP15(crn, crm, cp));
+	}
+	else
+	{
+		if (can_disassemble)
+			printf("mcr p15, #0, r%d, c%d, c%d, #%d\n", rd, crn, crm, cp);
+		BusInterface::WriteCP15(crn, crm, cp, GetReg(rd));
+	}
+
+	GetReg(15) += 4;
+}
+
+template <ARMVersion Version, class BusInterface>
+void ARMCore<Version, BusInterface>::ThumbBranchLinkExchange(uint16_t instr) requires (Version == ARMVersion::ARMv5TE)
+{
+	uint32_t target = (GetReg(14) + ((instr & 0x7FF) << 1)) & ~3;
+	SetReg(14, (GetReg(15) - 2) | 1);
+
+	if (can_disassemble)
+		printf("blx 0x%08x\n", target);
+
+	SetReg(15, target);
+	cpsr.flags.t = 0;
+	FlushPipeline();
+}
+
+template class ARMCore<ARMVersion::ARMv5TE, ARM9::BusInterface>;
+template class ARMCore<ARMVersion::ARMv4T, ARM7::BusInterface>;
+
+void InvalidateCodeCaches(bool is_arm9, uint32_t addr)
+{
+	uint32_t page = Bus::CodeAddress(is_arm9, addr) >> 12;
+	ARM9::Core::InvalidateCodePage(page);
+	ARM7::Core::InvalidateCodePage(page);
+}
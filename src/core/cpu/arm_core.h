@@ -0,0 +1,263 @@
+#pragma once
+
+#include <src/core/cpu/jit_x64.h>
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+union PSR
+{
+    uint32_t val;
+    struct
+    {
+        uint32_t mode : 5;
+        uint32_t t : 1;
+        uint32_t f : 1;
+        uint32_t i : 1;
+        uint32_t a : 1;
+        uint32_t e : 1;
+        uint32_t : 14;
+        uint32_t j : 1;
+        uint32_t : 2;
+        uint32_t q : 1;
+        uint32_t v : 1;
+        uint32_t c : 1;
+        uint32_t z : 1;
+        uint32_t n : 1;
+    } flags;
+};
+
+enum class ARMVersion
+{
+	ARMv4T, // ARM7TDMI
+	ARMv5TE, // ARM946E-S
+};
+
+// Interpreter shared by both CPUs. Every instance of the NDS has exactly one ARM9 and one ARM7,
+// so all state is static and each specialisation behaves like its own namespace.
+//
+// BusInterface must provide static Read8/16/32, Write8/16/32, IsInterruptAvailable(),
+// IsInterruptPending() and ExceptionBase(); ARMv5TE cores additionally need ReadCP15() and WriteCP15().
+template <ARMVersion Version, class BusInterface>
+class ARMCore
+{
+public:
+	static void Reset(uint32_t entry);
+	static void DirectBoot(uint32_t entry, uint32_t sp, uint32_t sp_irq, uint32_t sp_svc);
+	static void Run(int cycles);
+	static void Dump();
+
+	static void InvalidateCode(uint32_t addr);
+	static void InvalidateCodePage(uint32_t page);
+	static void InvalidateAllCode();
+
+	// Stops executing until an enabled interrupt is requested, whether or not IME lets it through
+	static void Halt();
+	// Halted, or spinning in a loop that can only end through an event. Either way the rest of
+	// the slice isn't worth running
+	static bool IsIdle();
+
+	static uint32_t& GetReg(int reg);
+	static void SetReg(int reg, uint32_t data);
+
+	// NZCV in here can be stale while flag_op says they're pending, see SyncFlags()
+	static inline PSR cpsr;
+
+	static inline bool can_disassemble = false;
+	static inline bool single_step = false;
+
+private:
+	enum Mode
+	{
+		MODE_USR = 0x10,
+		MODE_FIQ = 0x11,
+		MODE_IRQ = 0x12,
+		MODE_SVC = 0x13,
+		MODE_ABT = 0x17,
+		MODE_UND = 0x1B,
+		MODE_SYS = 0x1F,
+	};
+
+	using ARMHandler = void (*)(uint32_t instr);
+	using ThumbHandler = void (*)(uint16_t instr);
+
+	enum Bank
+	{
+		BANK_USR,
+		BANK_FIQ,
+		BANK_IRQ,
+		BANK_SVC,
+		BANK_ABT,
+		BANK_UND,
+		BANK_COUNT,
+	};
+
+	// Always the current mode's registers. Mode switches swap banked ones in and out of r_banked,
+	// which holds r8-r14 of each bank: all of them for FIQ and User, only r13-r14 for the others
+	static inline uint32_t r[16];
+	static inline uint32_t r_banked[BANK_COUNT][7];
+	static inline int bank = BANK_USR;
+
+	static inline PSR spsr_fiq, spsr_svc, spsr_abt, spsr_irq, spsr_und;
+	static inline PSR* cur_spsr = nullptr;
+
+	// Flag-setting instructions only record what they did, NZCV are worked out when something reads them
+	enum class FlagOp : uint8_t
+	{
+		None, // cpsr holds the flags
+		Logic, // N and Z from the result, C and V as recorded
+		Add, // flag_a + flag_b + carry in
+		Sub, // flag_a - flag_b - !carry in
+	};
+
+	static inline FlagOp flag_op = FlagOp::None;
+	static inline uint32_t flag_a, flag_b, flag_result;
+	static inline bool flag_carry, flag_v;
+
+	// A run of pre-decoded instructions, ending at the first one that normally leaves it
+	struct MicroOp
+	{
+		union
+		{
+			ARMHandler arm;
+			ThumbHandler thumb;
+		};
+		uint32_t instr;
+		uint8_t cond;
+	};
+
+	struct Block
+	{
+		std::vector<MicroOp> ops;
+
+		JIT::BlockFn native = nullptr;
+		uint32_t native_generation = 0;
+
+		// Nothing in it writes memory or changes mode, so looping on it is a candidate for an idle loop
+		bool may_idle = true;
+	};
+
+	static constexpr int max_block_size = 32;
+
+	// Blocks are keyed by their address with the T bit in bit 0
+	static inline std::unordered_map<uint32_t, Block> blocks;
+	static inline std::unordered_map<uint32_t, std::vector<uint32_t>> page_blocks;
+	static inline std::bitset<1 << 20> code_pages;
+	// Set when a write drops cached code or the CPU halts, so the running block can bail out
+	static inline uint32_t code_invalidated = 0;
+
+	static inline int cycles_left = 0;
+
+	static inline bool halted = false;
+	static inline bool idle = false;
+
+	// Registers and CPSR after the last pass through a block that branched back to itself.
+	// 2 is never a key, ARM code is word aligned
+	static inline uint32_t idle_key = 2;
+	static inline uint32_t idle_state[16];
+
+	static inline bool direct_booted = false;
+
+	static constexpr const char* name = Version == ARMVersion::ARMv5TE ? "ARM9" : "ARM7";
+
+	static void FlushPipeline();
+
+	static uint32_t CodePage(uint32_t addr);
+	static Block& CompileBlock(uint32_t addr, uint32_t key);
+	static bool EndsBlock(uint32_t instr);
+	static bool EndsThumbBlock(uint16_t instr);
+	static int RunBlock();
+	static bool IsSideEffectFree(const MicroOp& op, bool thumb);
+	static void CheckIdleLoop(bool may_idle, uint32_t key, uint32_t pc);
+	static void CompileNative(Block& block, uint32_t pc);
+	static bool IsNative(const MicroOp& op, bool thumb);
+	static void EmitNative(const MicroOp& op, bool thumb, uint32_t pc, bool& logic_flags);
+
+	static void SwitchMode(uint32_t mode);
+	static uint32_t& UserReg(int reg);
+	static void RestoreCPSR();
+	static void RaiseException(uint32_t mode, uint32_t vector, uint32_t return_address);
+	static void BranchExchange(uint32_t addr);
+
+	static bool CondPassed(uint8_t cond);
+
+	static uint8_t NZCV();
+	static bool FlagN();
+	static bool FlagZ();
+	static bool Carry();
+	static bool Overflow();
+	static void SyncFlags();
+	static void PrepareLogicFlags();
+
+	static void SetNZ(uint32_t result);
+	static void SetLogicFlags(uint32_t result, bool carry);
+	static uint32_t Add(uint32_t a, uint32_t b, bool carry, bool s);
+	static uint32_t Sub(uint32_t a, uint32_t b, bool carry, bool s);
+	static uint32_t Shift(uint32_t value, int type, uint32_t amount, bool immediate, bool& carry);
+
+	static uint32_t ReadRotated32(uint32_t addr);
+	static uint32_t ReadRotated16(uint32_t addr);
+	static uint32_t ReadSigned16(uint32_t addr);
+
+	static constexpr ARMHandler DecodeARM(uint32_t i);
+	static constexpr std::array<ARMHandler, 4096> GenerateARMTable();
+	static constexpr std::array<ThumbHandler, 1024> GenerateThumbTable();
+
+	static const std::array<ARMHandler, 4096> arm_table;
+	static const std::array<ThumbHandler, 1024> thumb_table;
+
+	static void ARMDataProcessing(uint32_t instr);
+	static void ARMPSRTransferMRS(uint32_t instr);
+	static void ARMPSRTransferMSR(uint32_t instr);
+	static void ARMBranchExchange(uint32_t instr);
+	static void ARMMultiply(uint32_t instr);
+	static void ARMMultiplyLong(uint32_t instr);
+	static void ARMSwap(uint32_t instr);
+	static void ARMHalfwordTransfer(uint32_t instr);
+	static void ARMSingleDataTransfer(uint32_t instr);
+	static void ARMBlockDataTransfer(uint32_t instr);
+	static void ARMBranch(uint32_t instr);
+	static void ARMSoftwareInterrupt(uint32_t instr);
+	static void ARMUndefined(uint32_t instr);
+
+	// ARMv5TE only, never instantiated for the ARM7
+	static void ARMBranchLinkExchange(uint32_t instr) requires (Version == ARMVersion::ARMv5TE);
+	static void ARMBranchLinkExchangeImm(uint32_t instr) requires (Version == ARMVersion::ARMv5TE);
+	static void ARMPreload(uint32_t instr) requires (Version == ARMVersion::ARMv5TE);
+	static void ARMCountLeadingZeros(uint32_t instr) requires (Version == ARMVersion::ARMv5TE);
+	static void ARMSaturatingArithmetic(uint32_t instr) requires (Version == ARMVersion::ARMv5TE);
+	static void ARMSignedMultiplyHalfword(uint32_t instr) requires (Version == ARMVersion::ARMv5TE);
+	static void ARMDoublewordTransfer(uint32_t instr) requires (Version == ARMVersion::ARMv5TE);
+	static void ARMCoprocessorTransfer(uint32_t instr) requires (Version == ARMVersion::ARMv5TE);
+
+	static void ThumbMoveShifted(uint16_t instr);
+	static void ThumbAddSubtract(uint16_t instr);
+	static void ThumbMovCmpAddSubImm(uint16_t instr);
+	static void ThumbALUOperation(uint16_t instr);
+	static void ThumbHiRegisterOperation(uint16_t instr);
+	static void ThumbPCRelativeLoad(uint16_t instr);
+	static void ThumbLoadStoreRegister(uint16_t instr);
+	static void ThumbLoadStoreSignExtended(uint16_t instr);
+	static void ThumbLoadStoreImmediate(uint16_t instr);
+	static void ThumbLoadStoreHalfword(uint16_t instr);
+	static void ThumbSPRelativeLoadStore(uint16_t instr);
+	static void ThumbLoadAddress(uint16_t instr);
+	static void ThumbAddOffsetToSP(uint16_t instr);
+	static void ThumbPushPop(uint16_t instr);
+	static void ThumbLoadStoreMultiple(uint16_t instr);
+	static void ThumbConditionalBranch(uint16_t instr);
+	static void ThumbSoftwareInterrupt(uint16_t instr);
+	static void ThumbUnconditionalBranch(uint16_t instr);
+	static void ThumbLongBranchLink(uint16_t instr);
+	static void ThumbUndefined(uint16_t instr);
+
+	// ARMv5TE only, never instantiated for the ARM7
+	static void ThumbBranchLinkExchange(uint16_t instr) requires (Version == ARMVersion::ARMv5TE);
+};
+
+// Called for every CPU write, drops cached blocks on the written page from both cores.
+// addr is as the writing CPU sees it
+void InvalidateCodeCaches(bool is_arm9, uint32_t addr);
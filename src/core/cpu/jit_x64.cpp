@@ -0,0 +1,445 @@
+#include <src/core/cpu/jit_x64.h>
+#include <src/core/log.h>
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace JIT
+{
+
+bool enabled = false;
+uint32_t generation = 0;
+
+#if defined(__x86_64__)
+
+constexpr size_t code_size = 32 * 1024 * 1024;
+
+// Worst case for a 32 instruction block is well under this
+constexpr size_t max_block_code = 16 * 1024;
+
+// The buffer is mapped twice, code is written through one view and run from the other,
+// so no page is ever writable and executable at once
+uint8_t* code = nullptr;
+uint8_t* exec = nullptr;
+uint8_t* cursor = nullptr;
+uint8_t* block_start = nullptr;
+
+// What rbx points at in the block being emitted
+const uint8_t* rbx_base = nullptr;
+
+bool Init()
+{
+	int fd = memfd_create("nds-jit", 0);
+	if (fd < 0 || ftruncate(fd, code_size) < 0)
+	{
+		LOG_WARN(JIT, "Couldn't allocate code buffer, falling back to the interpreter\n");
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+
+	void* write_view = mmap(nullptr, code_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	void* exec_view = mmap(nullptr, code_size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (write_view == MAP_FAILED || exec_view == MAP_FAILED)
+	{
+		LOG_WARN(JIT, "Couldn't map code buffer, falling back to the interpreter\n");
+		if (write_view != MAP_FAILED)
+			munmap(write_view, code_size);
+		if (exec_view != MAP_FAILED)
+			munmap(exec_view, code_size);
+		return false;
+	}
+
+	code = cursor = (uint8_t*)write_view;
+	exec = (uint8_t*)exec_view;
+	enabled = true;
+	return true;
+}
+
+void Emit8(uint8_t data)
+{
+	*cursor++ = data;
+}
+
+void Emit32(uint32_t data)
+{
+	memcpy(cursor, &data, 4);
+	cursor += 4;
+}
+
+void Emit64(uint64_t data)
+{
+	memcpy(cursor, &data, 8);
+	cursor += 8;
+}
+
+// ModRM and disp32 for [rbx + disp32]. Statics all sit in the same image, well within 2 GiB of
+// each other
+void EmitMem(uint8_t reg, const void* var)
+{
+	Emit8(0x83 | (reg << 3));
+	Emit32((const uint8_t*)var - rbx_base);
+}
+
+void BeginBlock()
+{
+	if (cursor + max_block_code > code + code_size)
+	{
+		cursor = code;
+		generation++;
+	}
+
+	block_start = cursor;
+}
+
+// Jumps in a block are relative and everything else is absolute, so it runs as is from the other view
+BlockFn EndBlock()
+{
+	return (BlockFn)(exec + (block_start - code));
+}
+
+void EmitPrologue(uint32_t* pc)
+{
+	rbx_base = (const uint8_t*)pc;
+
+	// push rbx keeps the stack 16-byte aligned for the calls below
+	Emit8(0x53);
+	// mov rbx, pc
+	Emit8(0x48);
+	Emit8(0xBB);
+	Emit64((uint64_t)pc);
+}
+
+void EmitExit(int executed)
+{
+	// mov eax, executed; pop rbx; ret
+	Emit8(0xB8);
+	Emit32(executed);
+	Emit8(0x5B);
+	Emit8(0xC3);
+}
+
+void EmitExitUnlessPC(uint32_t expected, int executed)
+{
+	// cmp dword [rbx], expected; je +7
+	Emit8(0x81);
+	Emit8(0x3B);
+	Emit32(expected);
+	Emit8(0x74);
+	Emit8(7);
+	EmitExit(executed);
+}
+
+void EmitExitUnlessEqual(const uint32_t* addr, uint32_t value, int executed)
+{
+	// mov rax, addr; cmp dword [rax], value; je +7
+	Emit8(0x48);
+	Emit8(0xB8);
+	Emit64((uint64_t)addr);
+	Emit8(0x81);
+	Emit8(0x38);
+	Emit32(value);
+	Emit8(0x74);
+	Emit8(7);
+	EmitExit(executed);
+}
+
+void EmitAdvancePC(uint32_t bytes)
+{
+	// add dword [rbx], bytes
+	if (bytes < 0x80)
+	{
+		Emit8(0x83);
+		Emit8(0x03);
+		Emit8(bytes);
+	}
+	else
+	{
+		Emit8(0x81);
+		Emit8(0x03);
+		Emit32(bytes);
+	}
+}
+
+void EmitCall(const void* fn, uint32_t arg)
+{
+	// mov edi, arg; mov rax, fn; call rax
+	Emit8(0xBF);
+	Emit32(arg);
+	Emit8(0x48);
+	Emit8(0xB8);
+	Emit64((uint64_t)fn);
+	Emit8(0xFF);
+	Emit8(0xD0);
+}
+
+uint8_t* EmitConditionCheck(const void* cond_passed, uint8_t cond)
+{
+	EmitCall(cond_passed, cond);
+	// test al, al; jz rel32
+	Emit8(0x84);
+	Emit8(0xC0);
+	Emit8(0x0F);
+	Emit8(0x84);
+	uint8_t* patch = cursor;
+	Emit32(0);
+	return patch;
+}
+
+uint8_t* EmitSkipIf(const void* var, int size, SkipIf skip)
+{
+	// cmp byte/dword [var], 0; jcc rel32
+	Emit8(size == 1 ? 0x80 : 0x83);
+	EmitMem(7, var);
+	Emit8(0);
+	Emit8(0x0F);
+	Emit8((uint8_t)skip);
+	uint8_t* patch = cursor;
+	Emit32(0);
+	return patch;
+}
+
+uint8_t* EmitJump()
+{
+	// jmp rel32
+	Emit8(0xE9);
+	uint8_t* patch = cursor;
+	Emit32(0);
+	return patch;
+}
+
+void PatchJump(uint8_t* at)
+{
+	uint32_t rel = cursor - (at + 4);
+	memcpy(at, &rel, 4);
+}
+
+void EmitLoadReg(int host_reg, int reg)
+{
+	// mov eax/ecx, [rbx + disp8]
+	Emit8(0x8B);
+	Emit8(host_reg ? 0x4B : 0x43);
+	Emit8((reg - 15) * 4);
+}
+
+void EmitStoreReg(int reg)
+{
+	// mov [rbx + disp8], eax
+	Emit8(0x89);
+	Emit8(0x43);
+	Emit8((reg - 15) * 4);
+}
+
+void EmitStoreRegImm(int reg, uint32_t value)
+{
+	// mov dword [rbx + disp8], value
+	Emit8(0xC7);
+	Emit8(0x43);
+	Emit8((reg - 15) * 4);
+	Emit32(value);
+}
+
+void EmitALUImm(ALUOp op, uint32_t imm)
+{
+	switch (op)
+	{
+	case ALUOp::And:
+		Emit8(0x25);
+		break;
+	case ALUOp::Xor:
+		Emit8(0x35);
+		break;
+	case ALUOp::Sub:
+		Emit8(0x2D);
+		break;
+	case ALUOp::Rsb:
+		// neg eax; add eax, imm
+		Emit8(0xF7);
+		Emit8(0xD8);
+		Emit8(0x05);
+		break;
+	case ALUOp::Add:
+		Emit8(0x05);
+		break;
+	case ALUOp::Or:
+		Emit8(0x0D);
+		break;
+	case ALUOp::Mov:
+		Emit8(0xB8);
+		break;
+	case ALUOp::Bic:
+		Emit8(0x25);
+		imm = ~imm;
+		break;
+	case ALUOp::Mvn:
+		Emit8(0xB8);
+		imm = ~imm;
+		break;
+	case ALUOp::Adc:
+		Emit8(0x15);
+		break;
+	case ALUOp::Sbc:
+		Emit8(0x1D);
+		break;
+	case ALUOp::Mul:
+		// imul eax, eax, imm
+		Emit8(0x69);
+		Emit8(0xC0);
+		break;
+	}
+
+	Emit32(imm);
+}
+
+void EmitALUReg(ALUOp op)
+{
+	switch (op)
+	{
+	case ALUOp::And:
+		Emit8(0x21);
+		break;
+	case ALUOp::Xor:
+		Emit8(0x31);
+		break;
+	case ALUOp::Sub:
+		Emit8(0x29);
+		break;
+	case ALUOp::Rsb:
+		// neg eax; add eax, ecx
+		Emit8(0xF7);
+		Emit8(0xD8);
+		Emit8(0x01);
+		break;
+	case ALUOp::Add:
+		Emit8(0x01);
+		break;
+	case ALUOp::Or:
+		Emit8(0x09);
+		break;
+	case ALUOp::Mov:
+		Emit8(0x89);
+		break;
+	case ALUOp::Bic:
+		// not ecx; and eax, ecx
+		Emit8(0xF7);
+		Emit8(0xD1);
+		Emit8(0x21);
+		break;
+	case ALUOp::Mvn:
+		// mov eax, ecx; not eax
+		Emit8(0x89);
+		Emit8(0xC8);
+		Emit8(0xF7);
+		Emit8(0xD0);
+		return;
+	case ALUOp::Adc:
+		Emit8(0x11);
+		break;
+	case ALUOp::Sbc:
+		Emit8(0x19);
+		break;
+	case ALUOp::Mul:
+		// imul eax, ecx
+		Emit8(0x0F);
+		Emit8(0xAF);
+		Emit8(0xC1);
+		return;
+	}
+
+	// op eax, ecx
+	Emit8(0xC8);
+}
+
+void EmitShiftImm(ShiftOp op, int amount)
+{
+	if (amount == 32)
+	{
+		if (op == ShiftOp::Lsr)
+		{
+			// bt eax, 31; mov eax, 0
+			Emit8(0x0F);
+			Emit8(0xBA);
+			Emit8(0xE0);
+			Emit8(31);
+			Emit8(0xB8);
+			Emit32(0);
+		}
+		else
+		{
+			// sar eax, 31; bt eax, 0
+			Emit8(0xC1);
+			Emit8(0xF8);
+			Emit8(31);
+			Emit8(0x0F);
+			Emit8(0xBA);
+			Emit8(0xE0);
+			Emit8(0);
+		}
+		return;
+	}
+
+	// shl/shr/sar eax, amount
+	Emit8(0xC1);
+	Emit8(op == ShiftOp::Lsl ? 0xE0 : (op == ShiftOp::Lsr ? 0xE8 : 0xF8));
+	Emit8(amount);
+}
+
+void EmitStoreResult(uint32_t* var)
+{
+	// mov [var], eax
+	Emit8(0x89);
+	EmitMem(0, var);
+}
+
+void EmitStoreByte(void* var, uint8_t value)
+{
+	// mov byte [var], value
+	Emit8(0xC6);
+	EmitMem(0, var);
+	Emit8(value);
+}
+
+void EmitStoreCarry(bool* var, bool inverted)
+{
+	// setc/setnc [var]
+	Emit8(0x0F);
+	Emit8(inverted ? 0x93 : 0x92);
+	EmitMem(0, var);
+}
+
+void EmitStoreOverflow(bool* var)
+{
+	// seto [var]
+	Emit8(0x0F);
+	Emit8(0x90);
+	EmitMem(0, var);
+}
+
+void EmitLoadCarry(const bool* var, bool inverted)
+{
+	// mov dl, [var]; then cmp dl, 1 sets the host carry if it's clear, add dl, 0xFF if it's set
+	Emit8(0x8A);
+	EmitMem(2, var);
+	Emit8(0x80);
+	Emit8(inverted ? 0xFA : 0xC2);
+	Emit8(inverted ? 0x01 : 0xFF);
+}
+
+#else
+
+bool Init()
+{
+	LOG_WARN(JIT, "Only supported on x86-64 hosts, falling back to the interpreter\n");
+	return false;
+}
+
+#endif
+
+}
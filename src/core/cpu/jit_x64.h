@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+
+// Optional x86-64 backend for the block cache. Every cached block is turned into a native
+// function that either performs an instruction inline or calls its interpreter handler
+namespace JIT
+{
+
+// Runs a translated block and returns the number of instructions it executed
+using BlockFn = int (*)();
+
+extern bool enabled;
+
+// Bumped whenever the code buffer is recycled, a BlockFn from an older generation is gone
+extern uint32_t generation;
+
+// Maps the code buffer. Returns false if the host can't run generated code
+bool Init();
+
+#if defined(__x86_64__)
+
+enum class ALUOp
+{
+	And,
+	Xor,
+	Sub,
+	Rsb,
+	Add,
+	Or,
+	Mov,
+	Bic,
+	Mvn,
+	Adc,
+	Sbc,
+	Mul,
+};
+
+enum class ShiftOp
+{
+	Lsl,
+	Lsr,
+	Asr,
+};
+
+// Jumps taken by EmitSkipIf, comparing a variable against 0
+enum class SkipIf : uint8_t
+{
+	Zero = 0x84,
+	NonZero = 0x85,
+	Negative = 0x88,
+	NotNegative = 0x89,
+};
+
+// Makes sure a whole block fits in the buffer, recycling it if it doesn't
+void BeginBlock();
+BlockFn EndBlock();
+
+// rbx holds the address of r15 for the whole block. The register file is flat, so the other
+// registers sit just below it
+void EmitPrologue(uint32_t* pc);
+void EmitExit(int executed);
+void EmitExitUnlessPC(uint32_t expected, int executed);
+void EmitExitUnlessEqual(const uint32_t* addr, uint32_t value, int executed);
+void EmitAdvancePC(uint32_t bytes);
+
+void EmitCall(const void* fn, uint32_t arg);
+
+// Calls cond_passed(cond) and jumps past the instruction if it returns false. The returned
+// location is patched with PatchJump once the target is known
+uint8_t* EmitConditionCheck(const void* cond_passed, uint8_t cond);
+// The same for a single flag the block knows the form of. size is 1 or 4 bytes
+uint8_t* EmitSkipIf(const void* var, int size, SkipIf skip);
+uint8_t* EmitJump();
+void PatchJump(uint8_t* at);
+
+// eax = r[reg] op (ecx = r[reg]) or an immediate, written back to a guest register.
+// The host flags are left as the op set them
+void EmitLoadReg(int host_reg, int reg);
+void EmitStoreReg(int reg);
+void EmitStoreRegImm(int reg, uint32_t value);
+void EmitALUImm(ALUOp op, uint32_t imm);
+void EmitALUReg(ALUOp op);
+// amount is 1-31, or 32 for LSR and ASR. The host carry flag gets the last bit shifted out
+void EmitShiftImm(ShiftOp op, int amount);
+
+// Variables outside the register file, addressed relative to rbx as well. ADC and SBC take the
+// host carry flag from EmitLoadCarry, inverted for SBC since x86 borrows where ARM carries
+void EmitStoreResult(uint32_t* var);
+void EmitStoreByte(void* var, uint8_t value);
+void EmitStoreCarry(bool* var, bool inverted);
+void EmitStoreOverflow(bool* var);
+void EmitLoadCarry(const bool* var, bool inverted);
+
+#endif
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Thumb
+{
+
+// THUMB instruction formats, in the order the ARM7TDMI data sheet numbers them
+enum class Format
+{
+	MoveShifted,
+	AddSubtract,
+	MovCmpAddSubImm,
+	ALUOperation,
+	HiRegisterOperation,
+	PCRelativeLoad,
+	LoadStoreRegister,
+	LoadStoreSignExtended,
+	LoadStoreImmediate,
+	LoadStoreHalfword,
+	SPRelativeLoadStore,
+	LoadAddress,
+	AddOffsetToSP,
+	PushPop,
+	LoadStoreMultiple,
+	ConditionalBranch,
+	SoftwareInterrupt,
+	UnconditionalBranch,
+	LongBranchLink,
+	BranchLinkExchange, // ARMv5 only, second half of BLX <label>
+	Undefined,
+	Count
+};
+
+// Every format can be told apart from the top 10 bits of the opcode
+constexpr Format Decode(uint16_t i)
+{
+	if ((i >> 13) == 0b000)
+		return ((i >> 11) & 0b11) == 0b11 ? Format::AddSubtract : Format::MoveShifted;
+	if ((i >> 13) == 0b001)
+		return Format::MovCmpAddSubImm;
+	if ((i >> 10) == 0b010000)
+		return Format::ALUOperation;
+	if ((i >> 10) == 0b010001)
+		return Format::HiRegisterOperation;
+	if ((i >> 11) == 0b01001)
+		return Format::PCRelativeLoad;
+	if ((i >> 12) == 0b0101)
+		return ((i >> 9) & 1) ? Format::LoadStoreSignExtended : Format::LoadStoreRegister;
+	if ((i >> 13) == 0b011)
+		return Format::LoadStoreImmediate;
+	if ((i >> 12) == 0b1000)
+		return Format::LoadStoreHalfword;
+	if ((i >> 12) == 0b1001)
+		return Format::SPRelativeLoadStore;
+	if ((i >> 12) == 0b1010)
+		return Format::LoadAddress;
+	if ((i >> 8) == 0b10110000)
+		return Format::AddOffsetToSP;
+	if ((i >> 12) == 0b1011 && ((i >> 9) & 0b11) == 0b10)
+		return Format::PushPop;
+	if ((i >> 12) == 0b1100)
+		return Format::LoadStoreMultiple;
+	if ((i >> 8) == 0b11011111)
+		return Format::SoftwareInterrupt;
+	if ((i >> 8) == 0b11011110)
+		return Format::Undefined;
+	if ((i >> 12) == 0b1101)
+		return Format::ConditionalBranch;
+	if ((i >> 11) == 0b11100)
+		return Format::UnconditionalBranch;
+	if ((i >> 11) == 0b11101)
+		return Format::BranchLinkExchange;
+	if ((i >> 12) == 0b1111)
+		return Format::LongBranchLink;
+	return Format::Undefined;
+}
+
+template <class Handler>
+using FormatHandlers = std::array<Handler, (size_t)Format::Count>;
+
+// Expands a per-format handler list into a table indexed by TableIndex()
+template <class Handler>
+constexpr std::array<Handler, 1024> GenerateTable(const FormatHandlers<Handler>& handlers)
+{
+	std::array<Handler, 1024> table{};
+
+	for (uint32_t index = 0; index < 1024; index++)
+		table[index] = handlers[(size_t)Decode(index << 6)];
+
+	return table;
+}
+
+constexpr uint32_t TableIndex(uint16_t i)
+{
+	return i >> 6;
+}
+
+}
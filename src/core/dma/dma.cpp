@@ -0,0 +1,237 @@
+#include "dma.h"
+
+#include <algorithm>
+#include <cstring>
+#include <src/core/bus.h>
+#include <src/core/cpu/arm_core.h>
+#include <src/core/mmio.h>
+#include <src/core/log.h>
+
+using DMA::Timing;
+
+struct Channel
+{
+	// As last written by the CPU
+	uint32_t sad;
+	uint32_t dad;
+	uint32_t cnt;
+
+	// Internal copies, latched when the channel gets enabled
+	uint32_t src;
+	uint32_t dst;
+	uint32_t count;
+};
+
+// Index 0 is the ARM9, 1 the ARM7
+Channel channels[2][4];
+uint32_t dma_fill[4];
+
+constexpr Timing arm9_timings[8] =
+{
+	Timing::Immediate, Timing::VBlank, Timing::HBlank, Timing::StartOfDisplay,
+	Timing::DisplayFIFO, Timing::Cartridge, Timing::GBASlot, Timing::GXFIFO,
+};
+
+constexpr Timing arm7_timings[4] = {Timing::Immediate, Timing::VBlank, Timing::Cartridge, Timing::Wireless};
+
+Timing GetTiming(bool is_arm9, uint32_t cnt)
+{
+	return is_arm9 ? arm9_timings[(cnt >> 27) & 7] : arm7_timings[(cnt >> 28) & 3];
+}
+
+// A count of 0 means the largest possible one
+void ReloadCount(bool is_arm9, int i, Channel& channel)
+{
+	uint32_t max = is_arm9 ? 0x200000 : (i == 3 ? 0x10000 : 0x4000);
+	channel.count = channel.cnt & (max - 1);
+	if (!channel.count)
+		channel.count = max;
+}
+
+void ReloadDestination(bool is_arm9, int i, Channel& channel)
+{
+	// ARM7 channels 0-2 can only write to the internal bus
+	channel.dst = channel.dad & ((is_arm9 || i == 3) ? 0x0FFFFFFF : 0x07FFFFFF);
+}
+
+void CopyUnit(bool is_arm9, bool word, uint32_t dst, uint32_t src)
+{
+	if (is_arm9)
+	{
+		if (word)
+			Bus::Write32(dst, Bus::Read32(src));
+		else
+			Bus::Write16(dst, Bus::Read16(src));
+	}
+	else
+	{
+		if (word)
+			Bus::Write32_ARM7(dst, Bus::Read32_ARM7(src));
+		else
+			Bus::Write16_ARM7(dst, Bus::Read16_ARM7(src));
+	}
+	InvalidateCodeCaches(is_arm9, dst);
+}
+
+void Transfer(bool is_arm9, Channel& channel, uint32_t units)
+{
+	bool word = channel.cnt & (1 << 26);
+	int unit = word ? 4 : 2;
+	int dst_control = (channel.cnt >> 21) & 3;
+	int src_control = (channel.cnt >> 23) & 3;
+	int dst_step = dst_control == 1 ? -unit : (dst_control == 2 ? 0 : unit);
+	int src_step = src_control == 1 ? -unit : (src_control == 2 ? 0 : unit);
+
+	channel.src &= ~(unit - 1);
+	channel.dst &= ~(unit - 1);
+
+	// Forward copies and fills between memory go a 1 KiB aligned piece at a time, that's how
+	// far a host pointer is good for
+	if (dst_step == unit && src_step >= 0)
+	{
+		while (units)
+		{
+			uint32_t n = std::min(units, (0x400 - (channel.dst & 0x3FF)) / unit);
+			if (src_step)
+				n = std::min(n, (0x400 - (channel.src & 0x3FF)) / unit);
+
+			uint8_t* src = Bus::GetHostPointer(is_arm9, channel.src, false);
+			uint8_t* dst = Bus::GetHostPointer(is_arm9, channel.dst, true);
+			uint32_t bytes = n * unit;
+
+			// A unit by unit copy onto itself repeats the start, which memmove wouldn't
+			if (!src || !dst || (src_step && dst > src && dst < src + bytes))
+				break;
+
+			if (src_step)
+				memmove(dst, src, bytes);
+			else
+			{
+				uint8_t value[4];
+				memcpy(value, src, unit);
+				for (uint32_t i = 0; i < bytes; i += unit)
+					memcpy(&dst[i], value, unit);
+			}
+			InvalidateCodeCaches(is_arm9, channel.dst);
+
+			channel.src += src_step ? bytes : 0;
+			channel.dst += bytes;
+			units -= n;
+		}
+	}
+
+	for (; units; units--)
+	{
+		CopyUnit(is_arm9, word, channel.dst, channel.src);
+		channel.src += src_step;
+		channel.dst += dst_step;
+	}
+}
+
+// Runs a channel that got its start condition
+void Run(bool is_arm9, int i)
+{
+	Channel& channel = channels[!is_arm9][i];
+	Timing timing = GetTiming(is_arm9, channel.cnt);
+
+	// The cartridge hands over a word at a time as they come in
+	uint32_t units = timing == Timing::Cartridge ? 1 : channel.count;
+
+	LOG_DEBUG(DMA, "ARM%d DMA%d: %d units from 0x%08x to 0x%08x\n", is_arm9 ? 9 : 7, i, units, channel.src, channel.dst);
+	Transfer(is_arm9, channel, units);
+
+	channel.count -= units;
+	if (channel.count)
+		return;
+
+	if ((channel.cnt & (1 << 25)) && timing != Timing::Immediate)
+	{
+		ReloadCount(is_arm9, i, channel);
+		if (((channel.cnt >> 21) & 3) == 3)
+			ReloadDestination(is_arm9, i, channel);
+	}
+	else
+		channel.cnt &= ~(1u << 31);
+
+	if (channel.cnt & (1 << 30))
+	{
+		if (is_arm9)
+			Bus::TriggerInterrupt9(8 + i);
+		else
+			Bus::TriggerInterrupt7(8 + i);
+	}
+}
+
+void WriteCNT(bool is_arm9, int i, uint32_t data)
+{
+	Channel& channel = channels[!is_arm9][i];
+	bool was_enabled = channel.cnt & (1u << 31);
+	channel.cnt = data;
+
+	if (was_enabled || !(data & (1u << 31)))
+		return;
+
+	channel.src = channel.sad & ((is_arm9 || i != 0) ? 0x0FFFFFFF : 0x07FFFFFF);
+	ReloadDestination(is_arm9, i, channel);
+	ReloadCount(is_arm9, i, channel);
+
+	// Geometry commands run as soon as they're written, so the GXFIFO is never too full to take more
+	Timing timing = GetTiming(is_arm9, data);
+	if (timing == Timing::Immediate || timing == Timing::GXFIFO)
+		Run(is_arm9, i);
+}
+
+void DMA::Trigger(bool is_arm9, Timing timing)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		Channel& channel = channels[!is_arm9][i];
+		if ((channel.cnt & (1u << 31)) && GetTiming(is_arm9, channel.cnt) == timing)
+			Run(is_arm9, i);
+	}
+}
+
+void DMA::Reset()
+{
+	memset(channels, 0, sizeof(channels));
+	memset(dma_fill, 0, sizeof(dma_fill));
+}
+
+template <bool is_arm9, int i>
+void RegisterChannel()
+{
+	constexpr uint8_t cpu = is_arm9 ? MMIO::CPU9 : MMIO::CPU7;
+	constexpr uint32_t base = 0x040000B0 + i * 12;
+
+	MMIO::Register(cpu, base, 4, nullptr, [](uint32_t data, uint32_t mask)
+	{
+		channels[!is_arm9][i].sad = MMIO::Merge(channels[!is_arm9][i].sad, data, mask);
+	});
+	MMIO::Register(cpu, base + 4, 4, nullptr, [](uint32_t data, uint32_t mask)
+	{
+		channels[!is_arm9][i].dad = MMIO::Merge(channels[!is_arm9][i].dad, data, mask);
+	});
+	MMIO::Register(cpu, base + 8, 4, []() -> uint32_t { return channels[!is_arm9][i].cnt; }, [](uint32_t data, uint32_t mask)
+	{
+		WriteCNT(is_arm9, i, MMIO::Merge(channels[!is_arm9][i].cnt, data, mask));
+	});
+
+	// Plain memory the ARM9 can use as a fill source
+	if constexpr (is_arm9)
+	{
+		MMIO::Register(MMIO::CPU9, 0x040000E0 + i * 4, 4, []() -> uint32_t { return dma_fill[i]; },
+			[](uint32_t data, uint32_t mask) { dma_fill[i] = MMIO::Merge(dma_fill[i], data, mask); });
+	}
+}
+
+template <int... i>
+void RegisterChannels(std::integer_sequence<int, i...>)
+{
+	(RegisterChannel<true, i>(), ...);
+	(RegisterChannel<false, i>(), ...);
+}
+
+void DMA::RegisterMMIO()
+{
+	RegisterChannels(std::make_integer_sequence<int, 4>());
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// The four DMA channels of each CPU. Transfers between plain memory are done as block copies,
+// everything else goes through the bus a unit at a time
+namespace DMA
+{
+
+// Start conditions, each CPU only has some of them
+enum class Timing
+{
+	Immediate,
+	VBlank,
+	HBlank,
+	StartOfDisplay,
+	DisplayFIFO,
+	Cartridge,
+	GBASlot,
+	GXFIFO,
+	Wireless,
+};
+
+void Reset();
+
+void RegisterMMIO();
+
+// Runs every enabled channel of that CPU waiting on timing
+void Trigger(bool is_arm9, Timing timing);
+
+}
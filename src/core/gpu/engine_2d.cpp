@@ -0,0 +1,874 @@
+#include <src/core/gpu/engine_2d.h>
+#include <src/core/gpu/renderer.h>
+#include <src/core/mmio.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Layer bits as used by WININ/WINOUT and BLDCNT, semi-transparent OBJs and translucent
+// 3D pixels get an extra bit
+constexpr uint16_t layer_obj = 1 << 4;
+constexpr uint16_t layer_backdrop = 1 << 5;
+constexpr uint16_t layer_effects = 1 << 5;
+constexpr uint16_t layer_semi = 1 << 6;
+constexpr uint16_t layer_3d = 1 << 7;
+
+enum BGType : uint8_t
+{
+	None,
+	Text,
+	Affine,
+	Extended,
+	Large,
+};
+
+// BG0-3 for each BG mode in DISPCNT, engine A replaces BG0 with 3D if DISPCNT bit 3 is set
+constexpr BGType bg_types[8][4] =
+{
+	{Text, Text, Text, Text},
+	{Text, Text, Text, Affine},
+	{Text, Text, Affine, Affine},
+	{Text, Text, Text, Extended},
+	{Text, Text, Affine, Extended},
+	{Text, Text, Extended, Extended},
+	{Text, None, Large, None},
+	{None, None, None, None},
+};
+
+// Width and height for each OBJ shape and size
+constexpr uint8_t obj_sizes[4][4][2] =
+{
+	{{8, 8}, {16, 16}, {32, 32}, {64, 64}},
+	{{16, 8}, {32, 8}, {32, 16}, {64, 32}},
+	{{8, 16}, {8, 32}, {16, 32}, {32, 64}},
+	{{8, 8}, {8, 8}, {8, 8}, {8, 8}},
+};
+
+Engine2D::Engine2D(bool is_engine_a, uint8_t* palette, uint8_t* oam, uint32_t bg_vram, uint32_t obj_vram)
+: is_engine_a(is_engine_a),
+  palette(palette),
+  oam(oam),
+  bg_vram(bg_vram),
+  obj_vram(obj_vram)
+{
+	dispcnt = 0;
+	memset(regs, 0, sizeof(regs));
+	ref_x[0] = ref_x[1] = ref_y[0] = ref_y[1] = 0;
+	memset(drawn, 0, sizeof(drawn));
+}
+
+void Engine2D::Registers::Reset()
+{
+	dispcnt = 0;
+	memset(io, 0, sizeof(io));
+	reference_written = 0;
+}
+
+uint32_t Engine2D::Registers::Read(uint32_t offset)
+{
+	switch (offset)
+	{
+	case 0x00:
+		return dispcnt;
+	case 0x08:
+	case 0x0A:
+	case 0x0C:
+	case 0x0E:
+	case 0x48:
+	case 0x4A:
+	case 0x50:
+	case 0x52:
+	case 0x6C:
+		return io[offset >> 1];
+	default:
+		// Scroll, affine, window coordinate, mosaic and BLDY registers are write only
+		return 0;
+	}
+}
+
+void Engine2D::Registers::Write(uint32_t offset, uint32_t data, uint32_t mask)
+{
+	if (offset == 0x00)
+	{
+		dispcnt = MMIO::Merge(dispcnt, data, mask);
+		return;
+	}
+
+	io[offset >> 1] = MMIO::Merge(io[offset >> 1], data, mask);
+
+	if (offset >= 0x28 && offset < 0x40 && (offset & 0xF) >= 8)
+		reference_written |= 1 << ((offset - 0x28) >> 4);
+}
+
+int32_t SignExtend28(uint32_t value)
+{
+	return (int32_t)(value << 4) >> 4;
+}
+
+void Engine2D::ReloadReference(int i)
+{
+	uint32_t base = 0x28 + i * 0x10;
+	ref_x[i] = SignExtend28(Reg(base) | (Reg(base + 2) << 16));
+	ref_y[i] = SignExtend28(Reg(base + 4) | (Reg(base + 6) << 16));
+}
+
+uint8_t Engine2D::ReadVRAM8(uint32_t addr)
+{
+	uint8_t* ptr = Renderer::MapVRAM(addr);
+	return ptr ? *ptr : 0;
+}
+
+uint16_t Engine2D::ReadVRAM16(uint32_t addr)
+{
+	uint8_t* ptr = Renderer::MapVRAM(addr);
+	return ptr ? *(uint16_t*)ptr : 0;
+}
+
+// 16 palettes of 256 colours per slot, used by 256 colour tiles once DISPCNT bit 30 is set.
+// BG0 and BG1 can take slots 2 and 3 instead
+uint8_t* Engine2D::BGExtPalette(int bg)
+{
+	if (!(dispcnt & (1 << 30)))
+		return nullptr;
+	if (bg < 2 && (Reg(0x08 + bg * 2) & (1 << 13)))
+		bg += 2;
+	return Renderer::MapBGExtPalette(is_engine_a, bg);
+}
+
+uint32_t Engine2D::CharBase(int bg)
+{
+	uint32_t base = bg_vram + ((Reg(0x08 + bg * 2) >> 2) & 0xF) * 0x4000;
+	if (is_engine_a)
+		base += ((dispcnt >> 24) & 7) * 0x10000;
+	return base;
+}
+
+uint32_t Engine2D::ScreenBase(int bg)
+{
+	uint32_t base = bg_vram + ((Reg(0x08 + bg * 2) >> 8) & 0x1F) * 0x800;
+	if (is_engine_a)
+		base += ((dispcnt >> 27) & 7) * 0x10000;
+	return base;
+}
+
+void Engine2D::RenderLine(int y, const Registers& registers, const uint32_t* line_3d, uint32_t memory_version, uint16_t* out)
+{
+	dispcnt = registers.dispcnt;
+	memcpy(regs, registers.io, sizeof(regs));
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (y == 0 || (registers.reference_written & (1 << i)))
+			ReloadReference(i);
+	}
+
+	LineState& state = drawn[y];
+	bool unchanged = state.valid && state.memory_version == memory_version && state.registers == registers
+		&& !memcmp(state.ref_x, ref_x, sizeof(ref_x)) && !memcmp(state.ref_y, ref_y, sizeof(ref_y));
+
+	if (!unchanged)
+	{
+		state.registers = registers;
+		memcpy(state.ref_x, ref_x, sizeof(ref_x));
+		memcpy(state.ref_y, ref_y, sizeof(ref_y));
+		state.memory_version = memory_version;
+		state.valid = true;
+		Draw(y, line_3d, out);
+	}
+
+	// Reference points move on every drawn line, whether the BG is shown or not
+	if (((dispcnt >> 16) & 3) == 1 && !(dispcnt & (1 << 7)))
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			ref_x[i] += (int16_t)Reg(0x22 + i * 0x10);
+			ref_y[i] += (int16_t)Reg(0x26 + i * 0x10);
+		}
+	}
+}
+
+void Engine2D::Draw(int y, const uint32_t* line_3d, uint16_t* out)
+{
+	switch ((dispcnt >> 16) & 3)
+	{
+	case 0:
+		std::fill(out, out + 256, 0xFFFF);
+		break;
+	case 1:
+		RenderGraphics(y, line_3d, out);
+		break;
+	case 2:
+	{
+		// VRAM display, straight from the LCDC mapping of bank A-D
+		uint8_t* line = Renderer::MapVRAM(0x06800000 + ((dispcnt >> 18) & 3) * 0x20000 + y * 512);
+		for (int x = 0; x < 256; x++)
+			out[x] = line ? *(uint16_t*)&line[x * 2] | 0x8000 : 0x8000;
+		break;
+	}
+	case 3:
+		// Main memory display needs the display FIFO DMA
+		std::fill(out, out + 256, 0xFFFF);
+		break;
+	}
+
+	ApplyMasterBrightness(out);
+}
+
+void Engine2D::RenderGraphics(int y, const uint32_t* line_3d, uint16_t* out)
+{
+	if (dispcnt & (1 << 7))
+	{
+		std::fill(out, out + 256, 0xFFFF);
+		return;
+	}
+
+	int mode = dispcnt & 7;
+
+	for (int bg = 0; bg < 4; bg++)
+	{
+		if (!(dispcnt & (1 << (8 + bg))))
+			continue;
+
+		if (bg == 0 && is_engine_a && (dispcnt & (1 << 3)))
+		{
+			Render3D(line_3d);
+			continue;
+		}
+
+		switch (bg_types[mode][bg])
+		{
+		case Text:
+			RenderText(bg, y);
+			break;
+		case Affine:
+			RenderAffine(bg);
+			break;
+		case Extended:
+			RenderExtended(bg);
+			break;
+		case Large:
+			RenderLarge(bg);
+			break;
+		case None:
+			memset(bg_line[bg], 0, sizeof(bg_line[bg]));
+			break;
+		}
+	}
+
+	if (dispcnt & (1 << 12))
+		RenderObjects(y);
+	else
+	{
+		memset(obj_line, 0, sizeof(obj_line));
+		memset(obj_window, 0, sizeof(obj_window));
+	}
+
+	RenderWindows(y);
+
+	uint16_t backdrop = BGPalette(0);
+	std::fill(top, top + 256, backdrop);
+	std::fill(second, second + 256, backdrop);
+	std::fill(top_id, top_id + 256, layer_backdrop);
+	std::fill(second_id, second_id + 256, layer_backdrop);
+
+	// Back to front. BGs with a lower number and OBJs win ties at the same priority
+	for (int p = 3; p >= 0; p--)
+	{
+		for (int bg = 3; bg >= 0; bg--)
+		{
+			if (!(dispcnt & (1 << (8 + bg))) || (Reg(0x08 + bg * 2) & 3) != p)
+				continue;
+
+			bool is_3d = bg == 0 && is_engine_a && (dispcnt & (1 << 3));
+			Stack(bg_line[bg], 1 << bg, 1 << bg, is_3d ? ids_3d : nullptr, nullptr, 0);
+		}
+
+		if (dispcnt & (1 << 12))
+			Stack(obj_line, 0, layer_obj, obj_ids, obj_prio, p);
+	}
+
+	Blend(out);
+}
+
+void Engine2D::Render3D(const uint32_t* line_3d)
+{
+	// The 3D layer only scrolls horizontally, by BG0HOFS
+	int hofs = (int16_t)(Reg(0x10) << 7) >> 7;
+
+	for (int x = 0; x < 256; x++)
+	{
+		int sx = x + hofs;
+		uint32_t pixel = (line_3d && sx >= 0 && sx < 256) ? line_3d[sx] : 0;
+		int alpha = (pixel >> 16) & 0x1F;
+
+		bg_line[0][x] = alpha ? (pixel & 0x7FFF) | 0x8000 : 0;
+		ids_3d[x] = 1 | (alpha < 31 ? layer_3d : 0);
+		alpha_3d[x] = (alpha + 1) >> 1;
+	}
+}
+
+void Engine2D::RenderText(int bg, int y)
+{
+	uint16_t bgcnt = Reg(0x08 + bg * 2);
+	int width = (bgcnt & (1 << 14)) ? 512 : 256;
+	int height = (bgcnt & (1 << 15)) ? 512 : 256;
+	bool bpp8 = bgcnt & (1 << 7);
+	uint32_t char_base = CharBase(bg);
+	uint32_t screen_base = ScreenBase(bg);
+
+	int hofs = Reg(0x10 + bg * 4) & 0x1FF;
+	int vofs = Reg(0x12 + bg * 4) & 0x1FF;
+	int yy = (y + vofs) & (height - 1);
+
+	uint16_t* out = bg_line[bg];
+	uint8_t* ext_palette = bpp8 ? BGExtPalette(bg) : nullptr;
+
+	for (int x = 0; x < 256;)
+	{
+		int xx = (x + hofs) & (width - 1);
+
+		// Each 2 KiB screen block holds 32x32 tiles
+		uint32_t block = (xx >> 8) + (yy >> 8) * (width >> 8);
+		uint16_t entry = ReadVRAM16(screen_base + block * 0x800 + ((yy & 0xFF) >> 3) * 64 + ((xx & 0xFF) >> 3) * 2);
+
+		int tile = entry & 0x3FF;
+		int ty = (entry & (1 << 11)) ? 7 - (yy & 7) : (yy & 7);
+
+		for (int px = xx & 7; px < 8 && x < 256; px++, x++)
+		{
+			int tx = (entry & (1 << 10)) ? 7 - px : px;
+
+			if (bpp8)
+			{
+				uint8_t index = ReadVRAM8(char_base + tile * 64 + ty * 8 + tx);
+				if (!index)
+					out[x] = 0;
+				else if (dispcnt & (1 << 30))
+					out[x] = ExtPalette(ext_palette, (entry >> 12) * 256 + index) | 0x8000;
+				else
+					out[x] = BGPalette(index) | 0x8000;
+			}
+			else
+			{
+				uint8_t data = ReadVRAM8(char_base + tile * 32 + ty * 4 + tx / 2);
+				uint8_t index = (tx & 1) ? data >> 4 : data & 0xF;
+				out[x] = index ? BGPalette((entry >> 12) * 16 + index) | 0x8000 : 0;
+			}
+		}
+	}
+}
+
+// Steps through the BG with the affine parameters and asks fetch for each texel that's
+// either inside the width x height area or wrapped into it
+template <typename Fetch>
+void RenderRotated(uint16_t* out, int32_t x, int32_t y, int16_t pa, int16_t pc, int width, int height, bool wrap, Fetch fetch)
+{
+	for (int i = 0; i < 256; i++, x += pa, y += pc)
+	{
+		int tx = x >> 8;
+		int ty = y >> 8;
+
+		if (wrap)
+		{
+			tx &= width - 1;
+			ty &= height - 1;
+		}
+		else if (tx < 0 || ty < 0 || tx >= width || ty >= height)
+		{
+			out[i] = 0;
+			continue;
+		}
+
+		out[i] = fetch(tx, ty);
+	}
+}
+
+void Engine2D::RenderAffine(int bg)
+{
+	uint16_t bgcnt = Reg(0x08 + bg * 2);
+	int size = 128 << ((bgcnt >> 14) & 3);
+	uint32_t char_base = CharBase(bg);
+	uint32_t screen_base = ScreenBase(bg);
+	int i = bg - 2;
+
+	RenderRotated(bg_line[bg], ref_x[i], ref_y[i], Reg(0x20 + i * 0x10), Reg(0x24 + i * 0x10), size, size, bgcnt & (1 << 13),
+		[&](int tx, int ty) -> uint16_t
+		{
+			uint8_t tile = ReadVRAM8(screen_base + (ty >> 3) * (size >> 3) + (tx >> 3));
+			uint8_t index = ReadVRAM8(char_base + tile * 64 + (ty & 7) * 8 + (tx & 7));
+			return index ? BGPalette(index) | 0x8000 : 0;
+		});
+}
+
+void Engine2D::RenderExtended(int bg)
+{
+	uint16_t bgcnt = Reg(0x08 + bg * 2);
+	int i = bg - 2;
+	int16_t pa = Reg(0x20 + i * 0x10);
+	int16_t pc = Reg(0x24 + i * 0x10);
+	bool wrap = bgcnt & (1 << 13);
+
+	if (!(bgcnt & (1 << 7)))
+	{
+		// Affine BG with text style 16-bit map entries, always 256 colours
+		int size = 128 << ((bgcnt >> 14) & 3);
+		uint32_t char_base = CharBase(bg);
+		uint32_t screen_base = ScreenBase(bg);
+		uint8_t* ext_palette = BGExtPalette(bg);
+
+		RenderRotated(bg_line[bg], ref_x[i], ref_y[i], pa, pc, size, size, wrap,
+			[&](int tx, int ty) -> uint16_t
+			{
+				uint16_t entry = ReadVRAM16(screen_base + ((ty >> 3) * (size >> 3) + (tx >> 3)) * 2);
+				int px = (entry & (1 << 10)) ? 7 - (tx & 7) : (tx & 7);
+				int py = (entry & (1 << 11)) ? 7 - (ty & 7) : (ty & 7);
+				uint8_t index = ReadVRAM8(char_base + (entry & 0x3FF) * 64 + py * 8 + px);
+				if (!index)
+					return 0;
+				if (dispcnt & (1 << 30))
+					return ExtPalette(ext_palette, (entry >> 12) * 256 + index) | 0x8000;
+				return BGPalette(index) | 0x8000;
+			});
+		return;
+	}
+
+	constexpr int bitmap_sizes[4][2] = {{128, 128}, {256, 256}, {512, 256}, {512, 512}};
+	int width = bitmap_sizes[(bgcnt >> 14) & 3][0];
+	int height = bitmap_sizes[(bgcnt >> 14) & 3][1];
+
+	// Bitmaps are placed in 16 KiB steps and ignore the DISPCNT screen base
+	uint32_t base = bg_vram + ((bgcnt >> 8) & 0x1F) * 0x4000;
+
+	if (bgcnt & (1 << 2))
+	{
+		RenderRotated(bg_line[bg], ref_x[i], ref_y[i], pa, pc, width, height, wrap,
+			[&](int tx, int ty) -> uint16_t
+			{
+				uint16_t color = ReadVRAM16(base + (ty * width + tx) * 2);
+				return (color & 0x8000) ? color : 0;
+			});
+	}
+	else
+	{
+		RenderRotated(bg_line[bg], ref_x[i], ref_y[i], pa, pc, width, height, wrap,
+			[&](int tx, int ty) -> uint16_t
+			{
+				uint8_t index = ReadVRAM8(base + ty * width + tx);
+				return index ? BGPalette(index) | 0x8000 : 0;
+			});
+	}
+}
+
+void Engine2D::RenderLarge(int bg)
+{
+	// A single 256 colour bitmap taking up all 512 KiB of BG VRAM
+	uint16_t bgcnt = Reg(0x08 + bg * 2);
+	int width = (bgcnt & (1 << 14)) ? 1024 : 512;
+	int height = (bgcnt & (1 << 14)) ? 512 : 1024;
+
+	RenderRotated(bg_line[bg], ref_x[0], ref_y[0], Reg(0x20), Reg(0x24), width, height, bgcnt & (1 << 13),
+		[&](int tx, int ty) -> uint16_t
+		{
+			uint8_t index = ReadVRAM8(bg_vram + ty * width + tx);
+			return index ? BGPalette(index) | 0x8000 : 0;
+		});
+}
+
+void Engine2D::RenderObjects(int y)
+{
+	memset(obj_line, 0, sizeof(obj_line));
+	memset(obj_window, 0, sizeof(obj_window));
+	std::fill(obj_prio, obj_prio + 256, 4);
+
+	for (int i = 0; i < 128; i++)
+	{
+		uint16_t attr0 = OAM16(i * 8);
+		uint16_t attr1 = OAM16(i * 8 + 2);
+		uint16_t attr2 = OAM16(i * 8 + 4);
+
+		bool affine = attr0 & (1 << 8);
+		if (!affine && (attr0 & (1 << 9)))
+			continue;
+
+		int mode = (attr0 >> 10) & 3;
+		int width = obj_sizes[attr0 >> 14][attr1 >> 14][0];
+		int height = obj_sizes[attr0 >> 14][attr1 >> 14][1];
+
+		// Double size affine OBJs get twice the area to rotate in
+		int bound_width = width;
+		int bound_height = height;
+		if (affine && (attr0 & (1 << 9)))
+		{
+			bound_width *= 2;
+			bound_height *= 2;
+		}
+
+		int line = (y - (attr0 & 0xFF)) & 0xFF;
+		if (line >= bound_height)
+			continue;
+
+		int sx = attr1 & 0x1FF;
+		if (sx >= 256)
+			sx -= 512;
+
+		int prio = (attr2 >> 10) & 3;
+		int tile = attr2 & 0x3FF;
+		bool bpp8 = attr0 & (1 << 13);
+
+		int16_t pa = 0x100, pb = 0, pc = 0, pd = 0x100;
+		if (affine)
+		{
+			int param = ((attr1 >> 9) & 0x1F) * 32;
+			pa = OAM16(param + 6);
+			pb = OAM16(param + 14);
+			pc = OAM16(param + 22);
+			pd = OAM16(param + 30);
+		}
+
+		for (int px = 0; px < bound_width; px++)
+		{
+			int x = sx + px;
+			if (x < 0 || x >= 256)
+				continue;
+
+			int tx, ty;
+			if (affine)
+			{
+				int cx = px - bound_width / 2;
+				int cy = line - bound_height / 2;
+				tx = ((pa * cx + pb * cy) >> 8) + width / 2;
+				ty = ((pc * cx + pd * cy) >> 8) + height / 2;
+				if (tx < 0 || ty < 0 || tx >= width || ty >= height)
+					continue;
+			}
+			else
+			{
+				tx = (attr1 & (1 << 12)) ? width - 1 - px : px;
+				ty = (attr1 & (1 << 13)) ? height - 1 - line : line;
+			}
+
+			uint16_t color;
+			if (mode == 3)
+			{
+				uint32_t addr;
+				if (dispcnt & (1 << 6))
+					addr = obj_vram + tile * ((dispcnt & (1 << 22)) ? 256 : 128) + (ty * width + tx) * 2;
+				else
+				{
+					// 2D bitmap OBJs sit in a 128 or 256 pixel wide bitmap of 8x8 tiles
+					int shift = (dispcnt & (1 << 5)) ? 5 : 4;
+					int mask = (1 << shift) - 1;
+					int stride = 8 << shift;
+					addr = obj_vram + (((tile >> shift) * 8 + ty) * stride + (tile & mask) * 8 + tx) * 2;
+				}
+
+				color = ReadVRAM16(addr);
+				if (!(color & 0x8000))
+					continue;
+			}
+			else
+			{
+				uint32_t tile_size = bpp8 ? 64 : 32;
+				uint32_t addr;
+				if (dispcnt & (1 << 4))
+					addr = obj_vram + tile * (32 << ((dispcnt >> 20) & 3)) + ((ty >> 3) * (width >> 3) + (tx >> 3)) * tile_size;
+				else
+					addr = obj_vram + tile * 32 + (ty >> 3) * 1024 + (tx >> 3) * tile_size;
+
+				uint8_t index;
+				if (bpp8)
+					index = ReadVRAM8(addr + (ty & 7) * 8 + (tx & 7));
+				else
+				{
+					uint8_t data = ReadVRAM8(addr + (ty & 7) * 4 + (tx & 7) / 2);
+					index = (tx & 1) ? data >> 4 : data & 0xF;
+				}
+
+				if (!index)
+					continue;
+				if (!bpp8)
+					color = OBJPalette((attr2 >> 12) * 16 + index);
+				else if (dispcnt & (1u << 31))
+					color = ExtPalette(Renderer::MapOBJExtPalette(is_engine_a), (attr2 >> 12) * 256 + index);
+				else
+					color = OBJPalette(index);
+			}
+
+			if (mode == 2)
+			{
+				obj_window[x] = 1;
+				continue;
+			}
+
+			// Earlier OBJs stay in front unless a later one has a higher priority
+			if (prio >= obj_prio[x])
+				continue;
+
+			obj_line[x] = color | 0x8000;
+			obj_prio[x] = prio;
+			obj_ids[x] = layer_obj | (mode == 1 ? layer_semi : 0);
+		}
+	}
+}
+
+void Engine2D::RenderWindows(int y)
+{
+	if (!(dispcnt & 0xE000))
+	{
+		std::fill(window, window + 256, 0x3F);
+		return;
+	}
+
+	uint16_t winin = Reg(0x48);
+	uint16_t winout = Reg(0x4A);
+
+	std::fill(window, window + 256, winout & 0x3F);
+
+	if (dispcnt & (1 << 15))
+	{
+		for (int x = 0; x < 256; x++)
+		{
+			if (obj_window[x])
+				window[x] = (winout >> 8) & 0x3F;
+		}
+	}
+
+	// Window 0 goes last so it ends up on top of window 1
+	for (int w = 1; w >= 0; w--)
+	{
+		if (!(dispcnt & (1 << (13 + w))))
+			continue;
+
+		uint16_t h = Reg(0x40 + w * 2);
+		uint16_t v = Reg(0x44 + w * 2);
+		int x1 = h >> 8, x2 = h & 0xFF;
+		int y1 = v >> 8, y2 = v & 0xFF;
+
+		// Coordinates past the right or bottom edge wrap around
+		bool inside_y = (y1 <= y2) ? (y >= y1 && y < y2) : (y >= y1 || y < y2);
+		if (!inside_y)
+			continue;
+
+		uint16_t enable = (winin >> (w * 8)) & 0x3F;
+		for (int x = 0; x < 256; x++)
+		{
+			if ((x1 <= x2) ? (x >= x1 && x < x2) : (x >= x1 || x < x2))
+				window[x] = enable;
+		}
+	}
+}
+
+#if defined(__SSE2__)
+
+__m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__m128i TestBits(__m128i value, uint16_t bits)
+{
+	__m128i zero = _mm_setzero_si128();
+	return _mm_andnot_si128(_mm_cmpeq_epi16(_mm_and_si128(value, _mm_set1_epi16(bits)), zero), _mm_set1_epi16(-1));
+}
+
+// Splits 8 BGR555 pixels into one vector per channel
+void Unpack(__m128i c, __m128i* ch)
+{
+	__m128i five = _mm_set1_epi16(0x1F);
+	ch[0] = _mm_and_si128(c, five);
+	ch[1] = _mm_and_si128(_mm_srli_epi16(c, 5), five);
+	ch[2] = _mm_and_si128(_mm_srli_epi16(c, 10), five);
+}
+
+__m128i Pack(__m128i* ch)
+{
+	return _mm_or_si128(ch[0], _mm_or_si128(_mm_slli_epi16(ch[1], 5), _mm_slli_epi16(ch[2], 10)));
+}
+
+__m128i AlphaBlend(__m128i a, __m128i b, __m128i eva, __m128i evb)
+{
+	__m128i ca[3], cb[3];
+	Unpack(a, ca);
+	Unpack(b, cb);
+	for (int i = 0; i < 3; i++)
+	{
+		__m128i sum = _mm_add_epi16(_mm_mullo_epi16(ca[i], eva), _mm_mullo_epi16(cb[i], evb));
+		ca[i] = _mm_min_epi16(_mm_srli_epi16(sum, 4), _mm_set1_epi16(31));
+	}
+	return Pack(ca);
+}
+
+__m128i Brightness(__m128i c, bool increase, __m128i evy)
+{
+	__m128i ch[3];
+	Unpack(c, ch);
+	for (int i = 0; i < 3; i++)
+	{
+		if (increase)
+			ch[i] = _mm_add_epi16(ch[i], _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(31), ch[i]), evy), 4));
+		else
+			ch[i] = _mm_sub_epi16(ch[i], _mm_srli_epi16(_mm_mullo_epi16(ch[i], evy), 4));
+	}
+	return Pack(ch);
+}
+
+void Engine2D::Stack(const uint16_t* color, uint16_t id, uint16_t window_bit, const uint16_t* ids, const uint16_t* prio, uint16_t p)
+{
+	__m128i opaque = _mm_set1_epi16((short)0x8000);
+
+	for (int x = 0; x < 256; x += 8)
+	{
+		__m128i c = _mm_load_si128((__m128i*)&color[x]);
+		__m128i mask = _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(c, opaque), opaque),
+			TestBits(_mm_load_si128((__m128i*)&window[x]), window_bit));
+		__m128i layer = _mm_set1_epi16(id);
+
+		if (prio)
+			mask = _mm_and_si128(mask, _mm_cmpeq_epi16(_mm_load_si128((__m128i*)&prio[x]), _mm_set1_epi16(p)));
+		if (ids)
+			layer = _mm_load_si128((__m128i*)&ids[x]);
+
+		__m128i old_top = _mm_load_si128((__m128i*)&top[x]);
+		__m128i old_id = _mm_load_si128((__m128i*)&top_id[x]);
+		_mm_store_si128((__m128i*)&second[x], Select(mask, old_top, _mm_load_si128((__m128i*)&second[x])));
+		_mm_store_si128((__m128i*)&second_id[x], Select(mask, old_id, _mm_load_si128((__m128i*)&second_id[x])));
+		_mm_store_si128((__m128i*)&top[x], Select(mask, c, old_top));
+		_mm_store_si128((__m128i*)&top_id[x], Select(mask, layer, old_id));
+	}
+}
+
+void Engine2D::Blend(uint16_t* out)
+{
+	uint16_t bldcnt = Reg(0x50);
+	int effect = (bldcnt >> 6) & 3;
+	__m128i eva = _mm_set1_epi16(std::min(Reg(0x52) & 0x1F, 16));
+	__m128i evb = _mm_set1_epi16(std::min((Reg(0x52) >> 8) & 0x1F, 16));
+	__m128i evy = _mm_set1_epi16(std::min(Reg(0x54) & 0x1F, 16));
+	__m128i none = _mm_setzero_si128();
+	__m128i all = _mm_set1_epi16(-1);
+
+	for (int x = 0; x < 256; x += 8)
+	{
+		__m128i t = _mm_load_si128((__m128i*)&top[x]);
+		__m128i s = _mm_load_si128((__m128i*)&second[x]);
+		__m128i tid = _mm_load_si128((__m128i*)&top_id[x]);
+		__m128i sid = _mm_load_si128((__m128i*)&second_id[x]);
+
+		__m128i enabled = TestBits(_mm_load_si128((__m128i*)&window[x]), layer_effects);
+		__m128i first_target = _mm_and_si128(enabled, TestBits(tid, bldcnt & 0x3F));
+		__m128i second_target = TestBits(sid, (bldcnt >> 8) & 0x3F);
+
+		// Semi-transparent OBJs and translucent 3D pixels blend with whatever is below regardless
+		// of the effect, 3D pixels by their own alpha
+		__m128i is_3d = TestBits(tid, layer_3d);
+		__m128i alpha = _mm_and_si128(second_target, _mm_or_si128(_mm_or_si128(TestBits(tid, layer_semi), is_3d),
+			effect == 1 ? first_target : none));
+		__m128i bright = _mm_andnot_si128(alpha, _mm_and_si128(first_target, effect >= 2 ? all : none));
+
+		__m128i a = _mm_load_si128((__m128i*)&alpha_3d[x]);
+		__m128i pixel_eva = Select(is_3d, a, eva);
+		__m128i pixel_evb = Select(is_3d, _mm_sub_epi16(_mm_set1_epi16(16), a), evb);
+
+		__m128i result = Select(alpha, AlphaBlend(t, s, pixel_eva, pixel_evb), t);
+		if (effect >= 2)
+			result = Select(bright, Brightness(t, effect == 2, evy), result);
+
+		_mm_storeu_si128((__m128i*)&out[x], _mm_or_si128(result, _mm_set1_epi16((short)0x8000)));
+	}
+}
+
+void Engine2D::ApplyMasterBrightness(uint16_t* out)
+{
+	uint16_t master = Reg(0x6C);
+	int mode = master >> 14;
+	if (mode != 1 && mode != 2)
+		return;
+
+	__m128i factor = _mm_set1_epi16(std::min(master & 0x1F, 16));
+	for (int x = 0; x < 256; x += 8)
+	{
+		__m128i c = _mm_loadu_si128((__m128i*)&out[x]);
+		_mm_storeu_si128((__m128i*)&out[x], _mm_or_si128(Brightness(c, mode == 1, factor), _mm_set1_epi16((short)0x8000)));
+	}
+}
+
+#else
+
+uint16_t AlphaBlend(uint16_t a, uint16_t b, int eva, int evb)
+{
+	uint16_t result = 0;
+	for (int shift = 0; shift < 15; shift += 5)
+	{
+		int c = (((a >> shift) & 0x1F) * eva + ((b >> shift) & 0x1F) * evb) >> 4;
+		result |= std::min(c, 31) << shift;
+	}
+	return result;
+}
+
+uint16_t Brightness(uint16_t color, bool increase, int evy)
+{
+	uint16_t result = 0;
+	for (int shift = 0; shift < 15; shift += 5)
+	{
+		int c = (color >> shift) & 0x1F;
+		c = increase ? c + (((31 - c) * evy) >> 4) : c - ((c * evy) >> 4);
+		result |= c << shift;
+	}
+	return result;
+}
+
+void Engine2D::Stack(const uint16_t* color, uint16_t id, uint16_t window_bit, const uint16_t* ids, const uint16_t* prio, uint16_t p)
+{
+	for (int x = 0; x < 256; x++)
+	{
+		if (!(color[x] & 0x8000) || !(window[x] & window_bit) || (prio && prio[x] != p))
+			continue;
+
+		second[x] = top[x];
+		second_id[x] = top_id[x];
+		top[x] = color[x];
+		top_id[x] = ids ? ids[x] : id;
+	}
+}
+
+void Engine2D::Blend(uint16_t* out)
+{
+	uint16_t bldcnt = Reg(0x50);
+	int effect = (bldcnt >> 6) & 3;
+	int eva = std::min(Reg(0x52) & 0x1F, 16);
+	int evb = std::min((Reg(0x52) >> 8) & 0x1F, 16);
+	int evy = std::min(Reg(0x54) & 0x1F, 16);
+
+	for (int x = 0; x < 256; x++)
+	{
+		bool first_target = (window[x] & layer_effects) && (top_id[x] & bldcnt & 0x3F);
+		bool second_target = second_id[x] & (bldcnt >> 8) & 0x3F;
+		uint16_t result = top[x];
+
+		if (second_target && (top_id[x] & layer_3d))
+			result = AlphaBlend(top[x], second[x], alpha_3d[x], 16 - alpha_3d[x]);
+		else if (second_target && ((top_id[x] & layer_semi) || (effect == 1 && first_target)))
+			result = AlphaBlend(top[x], second[x], eva, evb);
+		else if (effect >= 2 && first_target)
+			result = Brightness(top[x], effect == 2, evy);
+
+		out[x] = result | 0x8000;
+	}
+}
+
+void Engine2D::ApplyMasterBrightness(uint16_t* out)
+{
+	uint16_t master = Reg(0x6C);
+	int mode = master >> 14;
+	if (mode != 1 && mode != 2)
+		return;
+
+	for (int x = 0; x < 256; x++)
+		out[x] = Brightness(out[x], mode == 1, std::min(master & 0x1F, 16)) | 0x8000;
+}
+
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+
+// One of the two 2D engines. Each renders a scanline at a time from its own registers, half of
+// palette RAM and OAM, and the VRAM mapped to its BG and OBJ regions
+class Engine2D
+{
+public:
+	// The engine's registers as the CPU sees them. The renderer gets a copy for every line
+	struct Registers
+	{
+		uint32_t dispcnt;
+		uint16_t io[0x70 / 2];
+
+		// Bit 0 for BG2X/Y and bit 1 for BG3X/Y, set when written since the last copy
+		uint8_t reference_written;
+
+		void Reset();
+		bool operator==(const Registers&) const = default;
+
+		// offset is relative to the engine's register base, 0x04000000 or 0x04001000.
+		// Everything but DISPCNT is a halfword register
+		uint32_t Read(uint32_t offset);
+		void Write(uint32_t offset, uint32_t data, uint32_t mask);
+	};
+
+	// bg_vram and obj_vram are the ARM9 addresses of the engine's BG and OBJ VRAM regions
+	Engine2D(bool is_engine_a, uint8_t* palette, uint8_t* oam, uint32_t bg_vram, uint32_t obj_vram);
+
+	// Renders visible line y as 256 ABGR1555 pixels. The affine reference points restart
+	// from BGxX/Y on line 0 and whenever they were written. line_3d is the 3D engine's
+	// output for BG0, null on engine B. memory_version changes whenever anything the line
+	// is drawn from may have, if it and the registers match the last frame's line y, out
+	// is left alone
+	void RenderLine(int y, const Registers& registers, const uint32_t* line_3d, uint32_t memory_version, uint16_t* out);
+private:
+	void ReloadReference(int i);
+	void Draw(int y, const uint32_t* line_3d, uint16_t* out);
+	void RenderGraphics(int y, const uint32_t* line_3d, uint16_t* out);
+
+	void RenderText(int bg, int y);
+	void RenderAffine(int bg);
+	void RenderExtended(int bg);
+	void RenderLarge(int bg);
+	void Render3D(const uint32_t* line_3d);
+	void RenderObjects(int y);
+	void RenderWindows(int y);
+
+	// Puts the opaque pixels of color the window allows on top, pushing the old top pixel down.
+	// When prio is set only pixels with that priority are taken. ids replaces id per pixel
+	void Stack(const uint16_t* color, uint16_t id, uint16_t window_bit, const uint16_t* ids, const uint16_t* prio, uint16_t p);
+	void Blend(uint16_t* out);
+	void ApplyMasterBrightness(uint16_t* out);
+
+	uint8_t ReadVRAM8(uint32_t addr);
+	uint16_t ReadVRAM16(uint32_t addr);
+	uint16_t BGPalette(int index) { return *(uint16_t*)&palette[index * 2] & 0x7FFF; }
+	uint16_t OBJPalette(int index) { return *(uint16_t*)&palette[0x200 + index * 2] & 0x7FFF; }
+	uint16_t ExtPalette(const uint8_t* slot, int index) { return slot ? *(uint16_t*)&slot[index * 2] & 0x7FFF : 0; }
+	uint8_t* BGExtPalette(int bg);
+	uint16_t OAM16(int offset) { return *(uint16_t*)&oam[offset]; }
+
+	uint16_t Reg(uint32_t offset) { return regs[offset >> 1]; }
+	uint32_t CharBase(int bg);
+	uint32_t ScreenBase(int bg);
+
+	bool is_engine_a;
+	uint8_t* palette;
+	uint8_t* oam;
+	uint32_t bg_vram;
+	uint32_t obj_vram;
+
+	uint32_t dispcnt;
+	uint16_t regs[0x70 / 2];
+
+	// Internal copies of BG2X/Y and BG3X/Y, stepped by PB/PD after every line
+	int32_t ref_x[2];
+	int32_t ref_y[2];
+
+	// What every line was last drawn from
+	struct LineState
+	{
+		Registers registers;
+		int32_t ref_x[2];
+		int32_t ref_y[2];
+		uint32_t memory_version;
+		bool valid;
+	};
+	LineState drawn[192];
+
+	// Bit 15 marks an opaque pixel. Everything is 16 bits wide so the compositor can load
+	// 8 pixels of any of these at once
+	alignas(16) uint16_t bg_line[4][256];
+	alignas(16) uint16_t obj_line[256];
+	alignas(16) uint16_t obj_prio[256];
+	alignas(16) uint16_t obj_ids[256];
+	alignas(16) uint16_t window[256];
+	uint8_t obj_window[256];
+
+	// Layer ids of the 3D layer and its alpha as a 0-16 blend factor
+	alignas(16) uint16_t ids_3d[256];
+	alignas(16) uint16_t alpha_3d[256];
+
+	alignas(16) uint16_t top[256];
+	alignas(16) uint16_t top_id[256];
+	alignas(16) uint16_t second[256];
+	alignas(16) uint16_t second_id[256];
+};
@@ -2,186 +2,453 @@
 
 #include <cstdio>
 #include <cstdlib>
-#include <SDL2/SDL.h>
+#include <cstring>
+#include <utility>
 #include <src/core/bus.h>
+#include <src/core/dma/dma.h>
+#include <src/core/gpu/engine_2d.h>
+#include <src/core/gpu/gpu_3d.h>
+#include <src/core/gpu/renderer.h>
+#include <src/core/gpu/presenter.h>
+#include <src/core/mmio.h>
+#include <src/core/log.h>
+#include <src/core/scheduler/scheduler.h>
 
-uint8_t* VRAMA;
-uint8_t* VRAMB;
+// Palette RAM, OAM and VRAM as the CPU sees them. Writes mark 1 KiB chunks dirty, which are
+// copied over to the renderer before the next line is drawn
+uint8_t video_memory[GPU::video_memory_size];
+uint64_t dirty_chunks[(GPU::video_memory_size / Renderer::chunk_size + 63) / 64];
+
+GPU::VRAMMap vram_map;
+uint8_t vramcnt[GPU::vram_bank_count];
+
+Engine2D::Registers registers_a;
+Engine2D::Registers registers_b;
+
+uint16_t powcnt1 = 0;
 
 void GPU::Dump()
 {
-	std::ofstream vram_a("vram_a.dump");
-	std::ofstream vram_b("vram_b.dump");
+	for (int i = 0; i < vram_bank_count; i++)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "vram_%c.dump", 'a' + i);
 
-	for (int i = 0; i < 128*1024; i++)
+		std::ofstream out(name, std::ios::binary);
+		out.write((const char*)&video_memory[VRAMBankOffset(i)], vram_bank_sizes[i]);
+	}
+}
+
+void GPU::InitMem()
+{
+	memset(video_memory, 0, sizeof(video_memory));
+	memset(dirty_chunks, 0, sizeof(dirty_chunks));
+	memset(&vram_map, 0, sizeof(vram_map));
+	memset(vramcnt, 0, sizeof(vramcnt));
+	Renderer::Reset();
+}
+
+void GPU::Draw()
+{
+	const uint16_t* frame_a;
+	const uint16_t* frame_b;
+
+	Bus::ResetKeys();
+
+	Renderer::FinishFrame(&frame_a, &frame_b);
+	if (powcnt1 & (1 << 15))
+		Presenter::Present(frame_a, frame_b);
+	else
+		Presenter::Present(frame_b, frame_a);
+}
+
+void GPU::WriteDISPCNT(uint32_t data)
+{
+	registers_a.Write(0, data, 0xFFFFFFFF);
+}
+
+// Maps size bytes of bank at start, repeated every mirror bytes up to end
+void MapBank(uint8_t** pages, uint8_t* bank, uint32_t size, uint32_t start, uint32_t mirror, uint32_t end)
+{
+	for (uint32_t base = start; base < end; base += mirror)
 	{
-		vram_a << VRAMA[i];
-		vram_b << VRAMB[i];
+		for (uint32_t i = 0; i < size; i += 1 << GPU::vram_page_shift)
+			pages[((base + i) & 0xFFFFFF) >> GPU::vram_page_shift] = bank + i;
 	}
+}
 
-	vram_a.close();
-	vram_b.close();
+// Engine regions of the ARM9 space, each mirrored over its whole range
+void MapBGA(GPU::VRAMMap& map, uint8_t* bank, uint32_t size, uint32_t offset)
+{
+	MapBank(map.arm9, bank, size, 0x06000000 + offset, 0x80000, 0x06200000);
 }
 
-SDL_Window* window;
-SDL_Renderer* renderer;
-SDL_Texture* tex = nullptr;
+void MapBGB(GPU::VRAMMap& map, uint8_t* bank, uint32_t size, uint32_t offset)
+{
+	MapBank(map.arm9, bank, size, 0x06200000 + offset, 0x20000, 0x06400000);
+}
 
-void GPU::InitMem()
+void MapOBJA(GPU::VRAMMap& map, uint8_t* bank, uint32_t size, uint32_t offset)
 {
-	VRAMA = new uint8_t[128*1024];
-	VRAMB = new uint8_t[128*1024];
+	MapBank(map.arm9, bank, size, 0x06400000 + offset, 0x40000, 0x06600000);
+}
 
-	window = SDL_CreateWindow("NDS", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 256, 192*2, SDL_WINDOW_SHOWN);
-	renderer = SDL_CreateRenderer(window, -1, 0);
-	tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR1555, SDL_TEXTUREACCESS_STATIC, 256, 192);	
+void MapOBJB(GPU::VRAMMap& map, uint8_t* bank, uint32_t size, uint32_t offset)
+{
+	MapBank(map.arm9, bank, size, 0x06600000 + offset, 0x20000, 0x06800000);
 }
 
-uint8_t bitmap_bank = 0;
+// 16 KiB pages of a slot table starting at page first
+void MapSlots(uint8_t** slots, uint8_t* bank, uint32_t size, int first)
+{
+	for (uint32_t i = 0; i < size; i += 1 << GPU::vram_page_shift)
+		slots[first + (i >> GPU::vram_page_shift)] = bank + i;
+}
 
-void GPU::Draw()
+void MapExtPalettes(uint8_t** slots, uint8_t* bank, int count, int first)
 {
-	uint8_t* bank;
+	for (int i = 0; i < count; i++)
+		slots[first + i] = bank + i * 0x2000;
+}
 
-	Bus::ResetKeys();
+void GPU::BuildVRAMMap(const uint8_t* vramcnt, uint8_t* memory, VRAMMap& map)
+{
+	memset(&map, 0, sizeof(map));
 
-	switch (bitmap_bank)
+	// Where each bank sits in the LCDC region
+	constexpr uint32_t lcdc_addresses[vram_bank_count] =
 	{
-	case 0:
-		bank = VRAMA;
-		break;
-	default:
-		printf("Unknown bank %d\n", bitmap_bank);
-		exit(1);
-	}
+		0x06800000, 0x06820000, 0x06840000, 0x06860000, 0x06880000, 0x06890000, 0x06894000, 0x06898000, 0x068A0000,
+	};
 
-	SDL_Rect rect;
-	rect.x = 0;
-	rect.y = 0;
-	rect.w = 256;
-	rect.h = 192;
-
- 	SDL_UpdateTexture(tex, NULL, (void*)bank, 256*2);
-	
-	SDL_SetRenderDrawColor(renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
-	SDL_RenderClear(renderer);
-	
-	SDL_RenderCopy(renderer, tex, NULL, &rect);
-	
-	SDL_RenderPresent(renderer);
-
-	SDL_Event event;
-	while (SDL_PollEvent(&event))
+	for (int i = 0; i < vram_bank_count; i++)
 	{
-		switch (event.type)
+		if (!(vramcnt[i] & (1 << 7)))
+			continue;
+
+		uint8_t* bank = &memory[VRAMBankOffset(i)];
+		uint32_t size = vram_bank_sizes[i];
+		// Only C-G have a third MST bit
+		uint8_t mst = vramcnt[i] & ((i >= 2 && i <= 6) ? 7 : 3);
+		uint8_t offset = (vramcnt[i] >> 3) & 3;
+
+		if (mst == 0)
+		{
+			MapBank(map.arm9, bank, size, lcdc_addresses[i], size, lcdc_addresses[i] + size);
+			continue;
+		}
+
+		switch (i)
 		{
-		case SDL_KEYDOWN:
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+			if (mst == 1)
+				MapBGA(map, bank, size, offset * 0x20000);
+			else if (mst == 2 && i < 2)
+				MapOBJA(map, bank, size, (offset & 1) * 0x20000);
+			else if (mst == 2)
+				MapSlots(map.arm7, bank, size, (offset & 1) * (0x20000 >> vram_page_shift));
+			else if (mst == 3)
+				MapSlots(map.texture, bank, size, offset * (0x20000 >> vram_page_shift));
+			else if (mst == 4 && i == 2)
+				MapBGB(map, bank, size, 0);
+			else if (mst == 4 && i == 3)
+				MapOBJB(map, bank, size, 0);
+			break;
+		case 4:
+			if (mst == 1)
+				MapBGA(map, bank, size, 0);
+			else if (mst == 2)
+				MapOBJA(map, bank, size, 0);
+			else if (mst == 3)
+				MapSlots(map.texture_palette, bank, size, 0);
+			else if (mst == 4)
+				MapExtPalettes(map.bg_ext_palette[0], bank, 4, 0);
+			break;
+		case 5:
+		case 6:
 		{
-			if (event.key.keysym.sym == SDLK_DOWN)
-			{
-				Bus::PressKey(Bus::Keys::KEY_DOWN);
-			}
-			else
-			{
-				Bus::ReleaseKey(Bus::Keys::KEY_DOWN);
-			}
-			if (event.key.keysym.sym == SDLK_UP)
-			{
-				Bus::PressKey(Bus::Keys::KEY_UP);
-			}
-			else
-			{
-				Bus::ReleaseKey(Bus::Keys::KEY_UP);
-			}
-			if (event.key.keysym.sym == SDLK_RETURN)
-			{
-				Bus::PressKey(Bus::Keys::KEY_START);
-			}
-			else
-			{
-				Bus::ReleaseKey(Bus::Keys::KEY_START);
-			}
-			if (event.key.keysym.sym == SDLK_SPACE)
-			{
-				Bus::PressKey(Bus::Keys::KEY_SELECT);
-			}
-			else
-			{
-				Bus::ReleaseKey(Bus::Keys::KEY_SELECT);
-			}
+			// 16 KiB steps, offset bit 1 jumps ahead by 64 KiB
+			uint32_t step = (offset & 1) * 0x4000 + (offset >> 1) * 0x10000;
+			if (mst == 1)
+				MapBGA(map, bank, size, step);
+			else if (mst == 2)
+				MapOBJA(map, bank, size, step);
+			else if (mst == 3)
+				MapSlots(map.texture_palette, bank, size, (offset & 1) + (offset >> 1) * 4);
+			else if (mst == 4)
+				MapExtPalettes(map.bg_ext_palette[0], bank, 2, (offset & 1) * 2);
+			else if (mst == 5)
+				MapExtPalettes(map.obj_ext_palette, bank, 1, 0);
 			break;
 		}
-		case SDL_QUIT:
-			SDL_DestroyRenderer(renderer);
-			SDL_DestroyWindow(window);
-			exit(1);
+		case 7:
+			if (mst == 1)
+				MapBGB(map, bank, size, 0);
+			else if (mst == 2)
+				MapExtPalettes(map.bg_ext_palette[1], bank, 4, 0);
+			break;
+		case 8:
+			if (mst == 1)
+				MapBGB(map, bank, size, 0x8000);
+			else if (mst == 2)
+				MapOBJB(map, bank, size, 0);
+			else if (mst == 3)
+				MapExtPalettes(map.obj_ext_palette, bank, 1, 1);
 			break;
 		}
 	}
 }
 
-void GPU::WriteDISPCNT(uint32_t data)
+void GPU::WriteVRAMCNT(int bank, uint8_t data)
 {
-	bitmap_bank = (data >> 18) & 3;
-	printf("Using bitmap bank %d\n", bitmap_bank);
+	vramcnt[bank] = data;
+	BuildVRAMMap(vramcnt, video_memory, vram_map);
+	Renderer::PushMapping(vramcnt);
 }
 
-struct VRAMCNT
+void MarkDirty(uint8_t* ptr)
 {
-	uint8_t mst;
-	uint8_t offset;
-	bool enabled;
-} VRAMCNTA, VRAMCNTB;
-
-void GPU::WriteVRAMCNT_A(uint32_t data)
-{
-	VRAMCNTA.mst = (data & 7);
-	VRAMCNTA.offset = (data >> 3) & 2;
-	VRAMCNTA.enabled = (data >> 7) & 1;
-	if (VRAMCNTA.enabled)
-		printf("Enabling VRAM bank A\n");
+	uint32_t chunk = (ptr - video_memory) / Renderer::chunk_size;
+	dirty_chunks[chunk / 64] |= 1ull << (chunk % 64);
 }
 
-void GPU::WriteVRAMCNT_B(uint32_t data)
+uint8_t* GPU::MapVideoMemory(uint32_t addr, bool write)
 {
-	VRAMCNTB.mst = (data & 7);
-	VRAMCNTB.offset = (data >> 3) & 2;
-	VRAMCNTB.enabled = (data >> 7) & 1;
-	if (VRAMCNTB.enabled)
-		printf("Enabling VRAM bank B\n");
-}
+	uint8_t* ptr;
+
+	switch (addr >> 24)
+	{
+	case 0x05:
+		ptr = &video_memory[palette_offset + (addr & 0x7FF)];
+		break;
+	case 0x06:
+	{
+		uint8_t* page = vram_map.arm9[(addr & 0xFFFFFF) >> vram_page_shift];
+		if (!page)
+			return nullptr;
+		ptr = page + (addr & ((1 << vram_page_shift) - 1));
+		break;
+	}
+	case 0x07:
+		ptr = &video_memory[oam_offset + (addr & 0x7FF)];
+		break;
+	default:
+		return nullptr;
+	}
 
-bool dispStat = true;
+	if (write)
+		MarkDirty(ptr);
 
-// Simulate VBLANK for ARMWrestler
-uint16_t GPU::ReadDIPSTAT()
+	return ptr;
+}
+
+uint8_t* GPU::MapARM7VRAM(uint32_t addr, bool write)
 {
-	bool d = dispStat;
-	dispStat = !dispStat;
-	return d;
+	uint8_t* page = vram_map.arm7[(addr & 0x3FFFF) >> vram_page_shift];
+	if (!page)
+		return nullptr;
+
+	uint8_t* ptr = page + (addr & ((1 << vram_page_shift) - 1));
+	if (write)
+		MarkDirty(ptr);
+	return ptr;
 }
 
-void GPU::WriteLCDC(uint32_t addr, uint16_t halfword)
+// Sends every chunk written since the last line over to the renderer
+void FlushVideoMemory()
 {
-	if ((addr >= 0x06800000 && addr < 0x06820000) && VRAMCNTA.mst == 0)
+	for (size_t i = 0; i < sizeof(dirty_chunks) / sizeof(dirty_chunks[0]); i++)
 	{
-		if (VRAMCNTA.enabled)
+		while (dirty_chunks[i])
 		{
-			*(uint16_t*)&VRAMA[addr & 0x1FFFF] = halfword;
+			uint32_t chunk = i * 64 + __builtin_ctzll(dirty_chunks[i]);
+			dirty_chunks[i] &= dirty_chunks[i] - 1;
+			Renderer::PushMemory(chunk * Renderer::chunk_size, &video_memory[chunk * Renderer::chunk_size]);
 		}
-		return;
 	}
-	else if ((addr >= 0x06820000 && addr < 0x06840000) && VRAMCNTA.mst == 0)
+}
+
+// In ARM9 cycles, 355 dots of 6 ARM7 cycles each with HBlank starting after dot 256
+constexpr uint64_t hblank_start = 256 * 6 * 2;
+constexpr uint64_t line_length = 355 * 6 * 2;
+constexpr int visible_lines = 192;
+constexpr int total_lines = 263;
+
+uint16_t vcount = 0;
+
+// The status flags are shared, the IRQ enables and VCount setting are per CPU
+bool in_vblank = false;
+bool in_hblank = false;
+uint16_t dispstat9 = 0;
+uint16_t dispstat7 = 0;
+
+uint16_t VCountSetting(uint16_t dispstat)
+{
+	return (dispstat >> 8) | ((dispstat & (1 << 7)) << 1);
+}
+
+void CheckVCountMatch()
+{
+	if (vcount == VCountSetting(dispstat9) && (dispstat9 & (1 << 5)))
+		Bus::TriggerInterrupt9(2);
+	if (vcount == VCountSetting(dispstat7) && (dispstat7 & (1 << 5)))
+		Bus::TriggerInterrupt7(2);
+}
+
+void StartHBlank();
+
+void StartLine()
+{
+	in_hblank = false;
+
+	vcount++;
+	if (vcount == total_lines)
+		vcount = 0;
+
+	if (vcount == visible_lines)
 	{
-		if (VRAMCNTA.enabled)
-		{
-			*(uint16_t*)&VRAMB[addr & 0x1FFFF] = halfword;
-		}
-		return;
+		in_vblank = true;
+		if (dispstat9 & (1 << 3))
+			Bus::TriggerInterrupt9(0);
+		if (dispstat7 & (1 << 3))
+			Bus::TriggerInterrupt7(0);
+		GPU::Draw();
+		GPU3D::VBlank();
+		DMA::Trigger(true, DMA::Timing::VBlank);
+		DMA::Trigger(false, DMA::Timing::VBlank);
 	}
-	else
+	else if (vcount == total_lines - 1)
+		in_vblank = false;
+	else if (vcount == 0)
+		DMA::Trigger(true, DMA::Timing::StartOfDisplay);
+
+	CheckVCountMatch();
+
+	Scheduler::Schedule(hblank_start, StartHBlank);
+}
+
+void StartHBlank()
+{
+	in_hblank = true;
+
+	if (vcount < visible_lines)
 	{
-		printf("Writing to unknown LCDC address 0x%08x\n", addr);
-		exit(1);
+		FlushVideoMemory();
+		Renderer::PushLine(vcount, registers_a, registers_b);
+		registers_a.reference_written = registers_b.reference_written = 0;
+		DMA::Trigger(true, DMA::Timing::HBlank);
 	}
+
+	if (dispstat9 & (1 << 4))
+		Bus::TriggerInterrupt9(1);
+	if (dispstat7 & (1 << 4))
+		Bus::TriggerInterrupt7(1);
+
+	Scheduler::Schedule(line_length - hblank_start, StartLine);
+}
+
+void GPU::Reset()
+{
+	vcount = 0;
+	in_vblank = in_hblank = false;
+	dispstat9 = dispstat7 = 0;
+
+	registers_a.Reset();
+	registers_b.Reset();
+	GPU3D::Reset();
+
+	Scheduler::Cancel(StartLine);
+	Scheduler::Cancel(StartHBlank);
+	Scheduler::Schedule(hblank_start, StartHBlank);
+}
+
+uint16_t GPU::ReadDISPSTAT(bool is_arm9)
+{
+	uint16_t dispstat = is_arm9 ? dispstat9 : dispstat7;
+
+	dispstat &= 0xFFB8;
+	dispstat |= in_vblank;
+	dispstat |= in_hblank << 1;
+	dispstat |= (vcount == VCountSetting(dispstat)) << 2;
+	return dispstat;
+}
+
+void GPU::WriteDISPSTAT(uint16_t data, bool is_arm9)
+{
+	(is_arm9 ? dispstat9 : dispstat7) = data & 0xFFB8;
+}
+
+uint16_t GPU::ReadVCOUNT()
+{
+	return vcount;
+}
+
+template <Engine2D::Registers& registers, uint32_t offset>
+uint32_t ReadEngineRegister()
+{
+	return registers.Read(offset);
+}
+
+template <Engine2D::Registers& registers, uint32_t offset>
+void WriteEngineRegister(uint32_t data, uint32_t mask)
+{
+	registers.Write(offset, data, mask);
+}
+
+// Every halfword from start on, unused ones just keep what was written
+template <Engine2D::Registers& registers, uint32_t start, uint32_t... index>
+void RegisterEngine(uint32_t base, std::integer_sequence<uint32_t, index...>)
+{
+	(MMIO::Register(MMIO::CPU9, base + start + index * 2, 2, ReadEngineRegister<registers, start + index * 2>,
+		WriteEngineRegister<registers, start + index * 2>), ...);
+}
+
+template <int... bank>
+void RegisterVRAMCNT(uint32_t base)
+{
+	(MMIO::Register(MMIO::CPU9, base + bank, 1, nullptr, [](uint32_t data, uint32_t) { GPU::WriteVRAMCNT(bank, data); }), ...);
+}
+
+void GPU::RegisterMMIO()
+{
+	MMIO::Register(MMIO::CPU9, 0x04000000, 4, []() -> uint32_t { return registers_a.Read(0); },
+		[](uint32_t data, uint32_t mask) { registers_a.Write(0, data, mask); });
+	// Engine B has no 3D, VRAM display or extra char and screen base bits
+	MMIO::Register(MMIO::CPU9, 0x04001000, 4, []() -> uint32_t { return registers_b.Read(0); },
+		[](uint32_t data, uint32_t mask) { registers_b.Write(0, data & 0xC0B1FFF7, mask); });
+
+	// BG0CNT up to MASTER_BRIGHT, on engine A the 3D registers sit in between
+	RegisterEngine<registers_a, 0x08>(0x04000000, std::make_integer_sequence<uint32_t, (0x60 - 0x08) / 2>());
+	RegisterEngine<registers_a, 0x6C>(0x04000000, std::make_integer_sequence<uint32_t, 2>());
+	RegisterEngine<registers_b, 0x08>(0x04001000, std::make_integer_sequence<uint32_t, (0x70 - 0x08) / 2>());
+
+	MMIO::Register(MMIO::CPU9, 0x04000004, 2, []() -> uint32_t { return ReadDISPSTAT(true); },
+		[](uint32_t data, uint32_t mask) { WriteDISPSTAT(MMIO::Merge(dispstat9, data, mask), true); });
+	MMIO::Register(MMIO::CPU7, 0x04000004, 2, []() -> uint32_t { return ReadDISPSTAT(false); },
+		[](uint32_t data, uint32_t mask) { WriteDISPSTAT(MMIO::Merge(dispstat7, data, mask), false); });
+	MMIO::Register(MMIO::CPU_BOTH, 0x04000006, 2, []() -> uint32_t { return ReadVCOUNT(); }, nullptr);
+
+	// VRAMCNT_A-G, then WRAMCNT at 0x04000247 and VRAMCNT_H-I after it
+	RegisterVRAMCNT<0, 1, 2, 3, 4, 5, 6>(0x04000240);
+	RegisterVRAMCNT<7, 8>(0x04000248 - 7);
+
+	// The ARM7 can see whether C and D are mapped to it
+	MMIO::Register(MMIO::CPU7, 0x04000240, 1, []() -> uint32_t
+	{
+		uint32_t vramstat = 0;
+		for (int i = 0; i < 2; i++)
+		{
+			if ((vramcnt[2 + i] & 0x87) == 0x82)
+				vramstat |= 1 << i;
+		}
+		return vramstat;
+	}, nullptr);
+
+	MMIO::Register(MMIO::CPU9, 0x04000304, 2, []() -> uint32_t { return powcnt1; },
+		[](uint32_t data, uint32_t mask) { powcnt1 = MMIO::Merge(powcnt1, data, mask) & 0x820F; });
+
+	GPU3D::RegisterMMIO();
 }
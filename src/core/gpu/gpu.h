@@ -6,19 +6,78 @@
 namespace GPU
 {
 
+// Palette RAM, OAM and the VRAM banks share one block, which the renderer keeps a copy of
+constexpr uint32_t palette_offset = 0;
+constexpr uint32_t oam_offset = 0x800;
+constexpr uint32_t vram_offset = 0x1000;
+
+// Banks A-I, A-D are 128 KiB, E 64 KiB, F and G 16 KiB, H 32 KiB and I 16 KiB
+constexpr int vram_bank_count = 9;
+constexpr uint32_t vram_bank_sizes[vram_bank_count] = {0x20000, 0x20000, 0x20000, 0x20000, 0x10000, 0x4000, 0x4000, 0x8000, 0x4000};
+
+constexpr uint32_t VRAMBankOffset(int bank)
+{
+	uint32_t offset = vram_offset;
+	for (int i = 0; i < bank; i++)
+		offset += vram_bank_sizes[i];
+	return offset;
+}
+
+constexpr uint32_t video_memory_size = VRAMBankOffset(vram_bank_count);
+
+// One entry per 16 KiB of the ARM9's 0x06000000-0x06FFFFFF VRAM space
+constexpr int vram_page_shift = 14;
+constexpr int vram_page_count = 0x1000000 >> vram_page_shift;
+
+// The ARM7 sees up to two 128 KiB banks, mirrored every 256 KiB
+constexpr int arm7_vram_page_count = 0x40000 >> vram_page_shift;
+
+// The 3D engine's own view, 512 KiB of texture slots and 96 KiB of texture palette slots
+constexpr int texture_page_count = 0x80000 >> vram_page_shift;
+constexpr int texture_palette_page_count = 0x18000 >> vram_page_shift;
+
+// Where every bank shows up, rebuilt only when a VRAMCNT register changes so any VRAM
+// address resolves with one lookup. Unmapped entries are null
+struct VRAMMap
+{
+	// Engine A and B BG and OBJ regions and LCDC, all in the ARM9's address space
+	uint8_t* arm9[vram_page_count];
+	uint8_t* arm7[arm7_vram_page_count];
+
+	uint8_t* texture[texture_page_count];
+	uint8_t* texture_palette[texture_palette_page_count];
+
+	// 8 KiB slots, indexed by engine (0 for A), BG slots 0-3 and the OBJ slot
+	uint8_t* bg_ext_palette[2][4];
+	uint8_t* obj_ext_palette[2];
+};
+
+void BuildVRAMMap(const uint8_t* vramcnt, uint8_t* memory, VRAMMap& map);
+
 void Dump();
 
 void InitMem();
 
+// Schedules the first scanline, the display then keeps itself running from scheduler events
+void Reset();
+
+void RegisterMMIO();
+
 void Draw();
 
 void WriteDISPCNT(uint32_t data);
 
-void WriteVRAMCNT_A(uint32_t data);
-void WriteVRAMCNT_B(uint32_t data);
+void WriteVRAMCNT(int bank, uint8_t data);
+
+uint16_t ReadDISPSTAT(bool is_arm9);
+void WriteDISPSTAT(uint16_t data, bool is_arm9);
+uint16_t ReadVCOUNT();
 
-uint16_t ReadDIPSTAT();
+// Palette RAM, VRAM and OAM as seen by the ARM9, null for unmapped VRAM. Pass write if
+// the caller is going to store through the pointer so the renderer gets the new data
+uint8_t* MapVideoMemory(uint32_t addr, bool write);
 
-void WriteLCDC(uint32_t addr, uint16_t halfword);
+// The ARM7's 0x06000000-0x06FFFFFF, only banks C and D can be mapped there
+uint8_t* MapARM7VRAM(uint32_t addr, bool write);
 
 }
\ No newline at end of file
@@ -0,0 +1,1133 @@
+#include "gpu_3d.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <src/core/bus.h>
+#include <src/core/gpu/renderer.h>
+#include <src/core/log.h>
+#include <src/core/mmio.h>
+
+struct Matrix
+{
+	int32_t m[4][4];
+};
+
+constexpr Matrix identity = {{{0x1000, 0, 0, 0}, {0, 0x1000, 0, 0}, {0, 0, 0x1000, 0}, {0, 0, 0, 0x1000}}};
+
+// a x b, both 20.12 fixed point. Vectors are rows, so this applies a first
+Matrix Multiply(const Matrix& a, const Matrix& b)
+{
+	Matrix result;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			int64_t sum = 0;
+			for (int k = 0; k < 4; k++)
+				sum += (int64_t)a.m[i][k] * b.m[k][j];
+			result.m[i][j] = sum >> 12;
+		}
+	}
+	return result;
+}
+
+void Transform(const int32_t* in, const Matrix& m, int32_t* out)
+{
+	for (int j = 0; j < 4; j++)
+	{
+		int64_t sum = 0;
+		for (int i = 0; i < 4; i++)
+			sum += (int64_t)in[i] * m.m[i][j];
+		out[j] = sum >> 12;
+	}
+}
+
+int32_t SignExtend(uint32_t value, int bits)
+{
+	return (int32_t)(value << (32 - bits)) >> (32 - bits);
+}
+
+// Parameter count of every command, -1 for ones that don't exist
+int8_t param_counts[256];
+
+void InitParamCounts()
+{
+	std::fill(param_counts, param_counts + 256, -1);
+
+	const std::pair<uint8_t, int8_t> commands[] =
+	{
+		{0x00, 0},
+		{0x10, 1}, {0x11, 0}, {0x12, 1}, {0x13, 1}, {0x14, 1}, {0x15, 0}, {0x16, 16}, {0x17, 12},
+		{0x18, 16}, {0x19, 12}, {0x1A, 9}, {0x1B, 3}, {0x1C, 3},
+		{0x20, 1}, {0x21, 1}, {0x22, 1}, {0x23, 2}, {0x24, 1}, {0x25, 1}, {0x26, 1}, {0x27, 1},
+		{0x28, 1}, {0x29, 1}, {0x2A, 1}, {0x2B, 1},
+		{0x30, 1}, {0x31, 1}, {0x32, 1}, {0x33, 1}, {0x34, 32},
+		{0x40, 1}, {0x41, 0},
+		{0x50, 1},
+		{0x60, 1},
+		{0x70, 3}, {0x71, 2}, {0x72, 1},
+	};
+
+	for (auto [command, count] : commands)
+		param_counts[command] = count;
+}
+
+// Matrix state
+int matrix_mode = 0;
+Matrix projection, position, vector, texture;
+Matrix clip;
+Matrix projection_stack;
+Matrix position_stack[31];
+Matrix vector_stack[31];
+Matrix texture_stack;
+int projection_sp = 0;
+int position_sp = 0;
+bool stack_error = false;
+
+// Vertex state
+int32_t vertex[3];
+int32_t color[3];
+int32_t texcoord[2];
+int32_t raw_texcoord[2];
+uint32_t polygon_attr_pending = 0;
+uint32_t polygon_attr = 0;
+uint32_t texparam = 0;
+uint32_t palette_base = 0;
+uint32_t viewport = 0;
+
+// Lighting
+int32_t light_vectors[4][3];
+int32_t light_colors[4][3];
+int32_t diffuse[3], ambient[3], specular[3], emission[3];
+bool specular_table_enabled = false;
+uint8_t shininess[128];
+
+// Primitive assembly
+int primitive_type = 0;
+GPU3D::Vertex strip[4];
+int strip_count = 0;
+int strip_polygons = 0;
+
+// Geometry fills one list while the rasterizer draws the other
+GPU3D::PolygonList lists[2];
+int current_list = 0;
+
+// Test results
+bool box_test_result = false;
+int32_t pos_result[4];
+int16_t vec_result[3];
+
+// Commands
+uint32_t params[32];
+int param_count = 0;
+uint32_t fifo_commands = 0;
+int fifo_params = 0;
+uint8_t port_command = 0;
+
+// SWAP_BUFFERS halts the geometry engine until VBlank, commands sent meanwhile wait here
+bool swap_pending = false;
+uint32_t swap_params = 0;
+std::vector<uint32_t> halted_commands;
+
+// Rendering registers
+uint32_t disp3dcnt = 0;
+uint32_t gxstat = 0;
+uint16_t edge_colors[8];
+uint8_t alpha_test_ref = 0;
+uint32_t clear_color = 0;
+uint16_t clear_depth = 0;
+uint32_t fog_color = 0;
+uint16_t fog_offset = 0;
+uint8_t fog_table[32];
+uint16_t toon_table[32];
+
+void UpdateClipMatrix()
+{
+	clip = Multiply(position, projection);
+}
+
+void LoadMatrix(const Matrix& m)
+{
+	switch (matrix_mode)
+	{
+	case 0:
+		projection = m;
+		break;
+	case 1:
+		position = m;
+		break;
+	case 2:
+		position = m;
+		vector = m;
+		break;
+	case 3:
+		texture = m;
+		return;
+	}
+	UpdateClipMatrix();
+}
+
+void MultiplyMatrix(const Matrix& m)
+{
+	switch (matrix_mode)
+	{
+	case 0:
+		projection = Multiply(m, projection);
+		break;
+	case 1:
+		position = Multiply(m, position);
+		break;
+	case 2:
+		position = Multiply(m, position);
+		vector = Multiply(m, vector);
+		break;
+	case 3:
+		texture = Multiply(m, texture);
+		return;
+	}
+	UpdateClipMatrix();
+}
+
+Matrix MatrixFromParams(int rows, int cols)
+{
+	Matrix m = identity;
+	for (int i = 0; i < rows; i++)
+	{
+		for (int j = 0; j < cols; j++)
+			m.m[i][j] = params[i * cols + j];
+	}
+	return m;
+}
+
+void Push()
+{
+	switch (matrix_mode)
+	{
+	case 0:
+		if (projection_sp > 0)
+			stack_error = true;
+		projection_stack = projection;
+		projection_sp = 1;
+		break;
+	case 1:
+	case 2:
+		if (position_sp >= 31)
+		{
+			stack_error = true;
+			break;
+		}
+		position_stack[position_sp] = position;
+		vector_stack[position_sp] = vector;
+		position_sp++;
+		break;
+	case 3:
+		texture_stack = texture;
+		break;
+	}
+}
+
+void Pop(uint32_t param)
+{
+	switch (matrix_mode)
+	{
+	case 0:
+		if (projection_sp == 0)
+			stack_error = true;
+		projection_sp = 0;
+		projection = projection_stack;
+		UpdateClipMatrix();
+		break;
+	case 1:
+	case 2:
+		position_sp -= SignExtend(param, 6);
+		if (position_sp < 0 || position_sp > 30)
+		{
+			stack_error = true;
+			position_sp &= 31;
+			if (position_sp > 30)
+				break;
+		}
+		position = position_stack[position_sp];
+		vector = vector_stack[position_sp];
+		UpdateClipMatrix();
+		break;
+	case 3:
+		texture = texture_stack;
+		break;
+	}
+}
+
+void Store(uint32_t param)
+{
+	switch (matrix_mode)
+	{
+	case 0:
+		projection_stack = projection;
+		break;
+	case 1:
+	case 2:
+		if ((param & 31) == 31)
+			stack_error = true;
+		position_stack[param % 31] = position;
+		vector_stack[param % 31] = vector;
+		break;
+	case 3:
+		texture_stack = texture;
+		break;
+	}
+}
+
+void Restore(uint32_t param)
+{
+	switch (matrix_mode)
+	{
+	case 0:
+		projection = projection_stack;
+		UpdateClipMatrix();
+		break;
+	case 1:
+	case 2:
+		if ((param & 31) == 31)
+			stack_error = true;
+		position = position_stack[param % 31];
+		vector = vector_stack[param % 31];
+		UpdateClipMatrix();
+		break;
+	case 3:
+		texture = texture_stack;
+		break;
+	}
+}
+
+void Scale()
+{
+	// Only the position matrix is scaled in mode 2 so normals keep their length
+	Matrix* m = matrix_mode == 0 ? &projection : matrix_mode == 3 ? &texture : &position;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 4; j++)
+			m->m[i][j] = ((int64_t)m->m[i][j] * (int32_t)params[i]) >> 12;
+	}
+	UpdateClipMatrix();
+}
+
+void Translate()
+{
+	auto apply = [](Matrix& m)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			int64_t sum = (int64_t)m.m[3][j] << 12;
+			for (int i = 0; i < 3; i++)
+				sum += (int64_t)(int32_t)params[i] * m.m[i][j];
+			m.m[3][j] = sum >> 12;
+		}
+	};
+
+	switch (matrix_mode)
+	{
+	case 0:
+		apply(projection);
+		break;
+	case 1:
+		apply(position);
+		break;
+	case 2:
+		apply(position);
+		apply(vector);
+		break;
+	case 3:
+		apply(texture);
+		return;
+	}
+	UpdateClipMatrix();
+}
+
+void SetTexCoord(uint32_t param)
+{
+	raw_texcoord[0] = (int16_t)(param & 0xFFFF);
+	raw_texcoord[1] = (int16_t)(param >> 16);
+
+	// Mode 1 runs the coordinates through the texture matrix as (s, t, 1/16, 1/16)
+	if ((texparam >> 30) == 1)
+	{
+		const Matrix& m = texture;
+		texcoord[0] = ((int64_t)raw_texcoord[0] * m.m[0][0] + (int64_t)raw_texcoord[1] * m.m[1][0] + m.m[2][0] + m.m[3][0]) >> 12;
+		texcoord[1] = ((int64_t)raw_texcoord[0] * m.m[0][1] + (int64_t)raw_texcoord[1] * m.m[1][1] + m.m[2][1] + m.m[3][1]) >> 12;
+	}
+	else
+	{
+		texcoord[0] = raw_texcoord[0];
+		texcoord[1] = raw_texcoord[1];
+	}
+}
+
+void SetNormal(uint32_t param)
+{
+	int32_t normal[4] = {SignExtend(param, 10) << 3, SignExtend(param >> 10, 10) << 3, SignExtend(param >> 20, 10) << 3, 0};
+
+	if ((texparam >> 30) == 2)
+	{
+		const Matrix& m = texture;
+		texcoord[0] = (((int64_t)normal[0] * m.m[0][0] + (int64_t)normal[1] * m.m[1][0] + (int64_t)normal[2] * m.m[2][0]) >> 24) + raw_texcoord[0];
+		texcoord[1] = (((int64_t)normal[0] * m.m[0][1] + (int64_t)normal[1] * m.m[1][1] + (int64_t)normal[2] * m.m[2][1]) >> 24) + raw_texcoord[1];
+	}
+
+	int32_t n[4];
+	Transform(normal, vector, n);
+
+	int32_t result[3] = {emission[0], emission[1], emission[2]};
+
+	for (int l = 0; l < 4; l++)
+	{
+		if (!(polygon_attr & (1 << l)))
+			continue;
+
+		// Both vectors are 1.0 = 0x1000, the levels end up in 0..1
+		const int32_t* lv = light_vectors[l];
+		float dot = -((float)lv[0] * n[0] + (float)lv[1] * n[1] + (float)lv[2] * n[2]) / (4096.0f * 4096.0f);
+		float diffuse_level = std::max(0.0f, dot);
+
+		// Half way between the light and the line of sight, which is always (0, 0, -1)
+		float half[3] = {lv[0] / 8192.0f, lv[1] / 8192.0f, (lv[2] - 4096) / 8192.0f};
+		float shine = -(half[0] * n[0] + half[1] * n[1] + half[2] * n[2]) / 4096.0f;
+		float shininess_level = std::max(0.0f, shine);
+		shininess_level = std::min(1.0f, shininess_level * shininess_level);
+		if (specular_table_enabled)
+			shininess_level = shininess[std::min(127, (int)(shininess_level * 127))] / 255.0f;
+
+		for (int c = 0; c < 3; c++)
+		{
+			float light = light_colors[l][c] / 31.0f;
+			result[c] += (int32_t)(specular[c] * light * shininess_level + diffuse[c] * light * diffuse_level + ambient[c] * light);
+		}
+	}
+
+	for (int c = 0; c < 3; c++)
+		color[c] = std::clamp(result[c], 0, 31);
+}
+
+void SetLightVector(uint32_t param)
+{
+	int l = param >> 30;
+	int32_t direction[4] = {SignExtend(param, 10) << 3, SignExtend(param >> 10, 10) << 3, SignExtend(param >> 20, 10) << 3, 0};
+	int32_t transformed[4];
+	Transform(direction, vector, transformed);
+	for (int i = 0; i < 3; i++)
+		light_vectors[l][i] = transformed[i];
+}
+
+void UnpackColor(uint32_t data, int32_t* out)
+{
+	out[0] = data & 0x1F;
+	out[1] = (data >> 5) & 0x1F;
+	out[2] = (data >> 10) & 0x1F;
+}
+
+// Returns false for polygons that lie completely outside or cross the far plane when they
+// aren't allowed to
+bool ClipPolygon(GPU3D::Polygon& polygon)
+{
+	auto distance = [](const GPU3D::Vertex& v, int plane) -> int64_t
+	{
+		switch (plane)
+		{
+		case 0: return (int64_t)v.w + v.x;
+		case 1: return (int64_t)v.w - v.x;
+		case 2: return (int64_t)v.w + v.y;
+		case 3: return (int64_t)v.w - v.y;
+		case 4: return (int64_t)v.w + v.z;
+		default: return (int64_t)v.w - v.z;
+		}
+	};
+
+	bool keep_far = polygon.attr & (1 << 12);
+	for (int i = 0; i < polygon.count; i++)
+	{
+		if (!keep_far && distance(polygon.vertices[i], 5) < 0)
+			return false;
+	}
+
+	GPU3D::Vertex buffer[GPU3D::max_polygon_vertices];
+
+	for (int plane = 0; plane < 6; plane++)
+	{
+		int count = 0;
+		for (int i = 0; i < polygon.count; i++)
+		{
+			const GPU3D::Vertex& a = polygon.vertices[i];
+			const GPU3D::Vertex& b = polygon.vertices[(i + 1) % polygon.count];
+			int64_t da = distance(a, plane);
+			int64_t db = distance(b, plane);
+
+			// Ten vertices are enough for any convex polygon. Self-intersecting quads can cross a
+			// plane more often than that, those are dropped
+			int needed = (da >= 0) + ((da >= 0) != (db >= 0));
+			if (count + needed > GPU3D::max_polygon_vertices)
+				return false;
+
+			if (da >= 0)
+				buffer[count++] = a;
+
+			if ((da >= 0) != (db >= 0))
+			{
+				// New vertex where the edge crosses the plane
+				auto lerp = [&](int32_t x, int32_t y) { return (int32_t)(x + ((int64_t)y - (int64_t)x) * da / (da - db)); };
+				GPU3D::Vertex v;
+				v.x = lerp(a.x, b.x);
+				v.y = lerp(a.y, b.y);
+				v.z = lerp(a.z, b.z);
+				v.w = lerp(a.w, b.w);
+				v.r = lerp(a.r, b.r);
+				v.g = lerp(a.g, b.g);
+				v.b = lerp(a.b, b.b);
+				v.s = lerp(a.s, b.s);
+				v.t = lerp(a.t, b.t);
+				buffer[count++] = v;
+			}
+		}
+
+		if (count < 3)
+			return false;
+
+		memcpy(polygon.vertices, buffer, count * sizeof(GPU3D::Vertex));
+		polygon.count = count;
+	}
+
+	return true;
+}
+
+void FinishPolygon(GPU3D::Vertex* vertices, int count)
+{
+	GPU3D::PolygonList& list = lists[current_list];
+	if (list.count == GPU3D::max_polygons || list.vertex_count + count > GPU3D::max_vertices)
+	{
+		disp3dcnt |= 1 << 13;
+		return;
+	}
+
+	// Winding in homogeneous coordinates works whatever the sign of w
+	const GPU3D::Vertex& v0 = vertices[0];
+	const GPU3D::Vertex& v1 = vertices[1];
+	const GPU3D::Vertex& v2 = vertices[2];
+	double det = (double)v0.x * ((double)v1.y * v2.w - (double)v1.w * v2.y)
+		- (double)v0.y * ((double)v1.x * v2.w - (double)v1.w * v2.x)
+		+ (double)v0.w * ((double)v1.x * v2.y - (double)v1.y * v2.x);
+
+	bool front = det >= 0;
+	if (front ? !(polygon_attr & (1 << 7)) : !(polygon_attr & (1 << 6)))
+		return;
+
+	GPU3D::Polygon& polygon = list.polygons[list.count];
+	memcpy(polygon.vertices, vertices, count * sizeof(GPU3D::Vertex));
+	polygon.count = count;
+	polygon.attr = polygon_attr;
+	polygon.texparam = texparam;
+	polygon.palette_base = palette_base;
+
+	if (!ClipPolygon(polygon))
+		return;
+
+	int x1 = viewport & 0xFF;
+	int y1 = (viewport >> 8) & 0xFF;
+	int x2 = (viewport >> 16) & 0xFF;
+	int y2 = viewport >> 24;
+	int width = x2 - x1 + 1;
+	int height = y2 - y1 + 1;
+
+	polygon.top = 192;
+	polygon.bottom = 0;
+
+	for (int i = 0; i < polygon.count; i++)
+	{
+		GPU3D::Vertex& v = polygon.vertices[i];
+		int64_t w = v.w ? v.w : 1;
+
+		// Viewport y counts up from the bottom of the screen
+		v.screen_x = ((int64_t)(v.x + w) * width) / (2 * w) + x1;
+		v.screen_y = ((int64_t)(w - v.y) * height) / (2 * w) + 191 - y2;
+
+		if (list.w_buffer)
+			v.depth = std::clamp<int64_t>(v.w, 0, 0xFFFFFF);
+		else
+			v.depth = std::clamp<int64_t>(((((int64_t)v.z << 14) / w) + 0x3FFF) * 0x200, 0, 0xFFFFFF);
+
+		polygon.top = std::min(polygon.top, v.screen_y);
+		polygon.bottom = std::max(polygon.bottom, v.screen_y);
+	}
+
+	// Translucent polygons go after the opaque ones, A3I5 and A5I3 textures are always treated as such
+	uint32_t alpha = (polygon_attr >> 16) & 0x1F;
+	uint32_t format = (texparam >> 26) & 7;
+	polygon.translucent = (alpha != 0 && alpha != 31) || format == 1 || format == 6;
+
+	list.count++;
+	list.vertex_count += polygon.count;
+}
+
+void SubmitVertex()
+{
+	int32_t in[4] = {vertex[0], vertex[1], vertex[2], 0x1000};
+	int32_t out[4];
+	Transform(in, clip, out);
+
+	if ((texparam >> 30) == 3)
+	{
+		const Matrix& m = texture;
+		texcoord[0] = (((int64_t)vertex[0] * m.m[0][0] + (int64_t)vertex[1] * m.m[1][0] + (int64_t)vertex[2] * m.m[2][0]) >> 24) + raw_texcoord[0];
+		texcoord[1] = (((int64_t)vertex[0] * m.m[0][1] + (int64_t)vertex[1] * m.m[1][1] + (int64_t)vertex[2] * m.m[2][1]) >> 24) + raw_texcoord[1];
+	}
+
+	GPU3D::Vertex v;
+	v.x = out[0];
+	v.y = out[1];
+	v.z = out[2];
+	v.w = out[3];
+	v.r = color[0];
+	v.g = color[1];
+	v.b = color[2];
+	v.s = texcoord[0];
+	v.t = texcoord[1];
+
+	strip[strip_count++] = v;
+
+	switch (primitive_type)
+	{
+	case 0:
+		if (strip_count == 3)
+		{
+			FinishPolygon(strip, 3);
+			strip_count = 0;
+		}
+		break;
+	case 1:
+		if (strip_count == 4)
+		{
+			FinishPolygon(strip, 4);
+			strip_count = 0;
+		}
+		break;
+	case 2:
+		if (strip_count == 3)
+		{
+			// Every other triangle of a strip is wound the other way round
+			if (strip_polygons & 1)
+			{
+				GPU3D::Vertex flipped[3] = {strip[1], strip[0], strip[2]};
+				FinishPolygon(flipped, 3);
+			}
+			else
+				FinishPolygon(strip, 3);
+
+			strip_polygons++;
+			strip[0] = strip[1];
+			strip[1] = strip[2];
+			strip_count = 2;
+		}
+		break;
+	case 3:
+		if (strip_count == 4)
+		{
+			GPU3D::Vertex quad[4] = {strip[0], strip[1], strip[3], strip[2]};
+			FinishPolygon(quad, 4);
+			strip[0] = strip[2];
+			strip[1] = strip[3];
+			strip_count = 2;
+		}
+		break;
+	}
+}
+
+void BoxTest()
+{
+	int32_t box[6] =
+	{
+		(int16_t)(params[0] & 0xFFFF), (int16_t)(params[0] >> 16),
+		(int16_t)(params[1] & 0xFFFF), (int16_t)(params[1] >> 16),
+		(int16_t)(params[2] & 0xFFFF), (int16_t)(params[2] >> 16),
+	};
+
+	// Inside unless all eight corners are beyond the same plane
+	int outside_all = 0x3F;
+	for (int i = 0; i < 8; i++)
+	{
+		int32_t in[4] =
+		{
+			box[0] + ((i & 1) ? box[3] : 0),
+			box[1] + ((i & 2) ? box[4] : 0),
+			box[2] + ((i & 4) ? box[5] : 0),
+			0x1000,
+		};
+		int32_t out[4];
+		Transform(in, clip, out);
+
+		int outside = 0;
+		outside |= (out[0] < -out[3]) << 0;
+		outside |= (out[0] > out[3]) << 1;
+		outside |= (out[1] < -out[3]) << 2;
+		outside |= (out[1] > out[3]) << 3;
+		outside |= (out[2] < -out[3]) << 4;
+		outside |= (out[2] > out[3]) << 5;
+		outside_all &= outside;
+	}
+
+	box_test_result = outside_all == 0;
+}
+
+void Execute(uint8_t command)
+{
+	if (swap_pending)
+	{
+		halted_commands.push_back(command);
+		halted_commands.push_back(param_counts[command]);
+		halted_commands.insert(halted_commands.end(), params, params + param_counts[command]);
+		return;
+	}
+
+	switch (command)
+	{
+	case 0x00:
+		break;
+	case 0x10:
+		matrix_mode = params[0] & 3;
+		break;
+	case 0x11:
+		Push();
+		break;
+	case 0x12:
+		Pop(params[0]);
+		break;
+	case 0x13:
+		Store(params[0]);
+		break;
+	case 0x14:
+		Restore(params[0]);
+		break;
+	case 0x15:
+		LoadMatrix(identity);
+		break;
+	case 0x16:
+		LoadMatrix(MatrixFromParams(4, 4));
+		break;
+	case 0x17:
+		LoadMatrix(MatrixFromParams(4, 3));
+		break;
+	case 0x18:
+		MultiplyMatrix(MatrixFromParams(4, 4));
+		break;
+	case 0x19:
+		MultiplyMatrix(MatrixFromParams(4, 3));
+		break;
+	case 0x1A:
+		MultiplyMatrix(MatrixFromParams(3, 3));
+		break;
+	case 0x1B:
+		Scale();
+		break;
+	case 0x1C:
+		Translate();
+		break;
+	case 0x20:
+		UnpackColor(params[0], color);
+		break;
+	case 0x21:
+		SetNormal(params[0]);
+		break;
+	case 0x22:
+		SetTexCoord(params[0]);
+		break;
+	case 0x23:
+		vertex[0] = (int16_t)(params[0] & 0xFFFF);
+		vertex[1] = (int16_t)(params[0] >> 16);
+		vertex[2] = (int16_t)(params[1] & 0xFFFF);
+		SubmitVertex();
+		break;
+	case 0x24:
+		vertex[0] = SignExtend(params[0], 10) << 6;
+		vertex[1] = SignExtend(params[0] >> 10, 10) << 6;
+		vertex[2] = SignExtend(params[0] >> 20, 10) << 6;
+		SubmitVertex();
+		break;
+	case 0x25:
+		vertex[0] = (int16_t)(params[0] & 0xFFFF);
+		vertex[1] = (int16_t)(params[0] >> 16);
+		SubmitVertex();
+		break;
+	case 0x26:
+		vertex[0] = (int16_t)(params[0] & 0xFFFF);
+		vertex[2] = (int16_t)(params[0] >> 16);
+		SubmitVertex();
+		break;
+	case 0x27:
+		vertex[1] = (int16_t)(params[0] & 0xFFFF);
+		vertex[2] = (int16_t)(params[0] >> 16);
+		SubmitVertex();
+		break;
+	case 0x28:
+		vertex[0] += SignExtend(params[0], 10);
+		vertex[1] += SignExtend(params[0] >> 10, 10);
+		vertex[2] += SignExtend(params[0] >> 20, 10);
+		SubmitVertex();
+		break;
+	case 0x29:
+		polygon_attr_pending = params[0];
+		break;
+	case 0x2A:
+		texparam = params[0];
+		break;
+	case 0x2B:
+		palette_base = params[0] & 0x1FFF;
+		break;
+	case 0x30:
+		UnpackColor(params[0], diffuse);
+		UnpackColor(params[0] >> 16, ambient);
+		if (params[0] & (1 << 15))
+			UnpackColor(params[0], color);
+		break;
+	case 0x31:
+		UnpackColor(params[0], specular);
+		UnpackColor(params[0] >> 16, emission);
+		specular_table_enabled = params[0] & (1 << 15);
+		break;
+	case 0x32:
+		SetLightVector(params[0]);
+		break;
+	case 0x33:
+		UnpackColor(params[0], light_colors[params[0] >> 30]);
+		break;
+	case 0x34:
+		for (int i = 0; i < 32; i++)
+		{
+			for (int j = 0; j < 4; j++)
+				shininess[i * 4 + j] = params[i] >> (j * 8);
+		}
+		break;
+	case 0x40:
+		primitive_type = params[0] & 3;
+		polygon_attr = polygon_attr_pending;
+		strip_count = 0;
+		strip_polygons = 0;
+		break;
+	case 0x41:
+		break;
+	case 0x50:
+		swap_pending = true;
+		swap_params = params[0];
+		break;
+	case 0x60:
+		viewport = params[0];
+		break;
+	case 0x70:
+		BoxTest();
+		break;
+	case 0x71:
+	{
+		vertex[0] = (int16_t)(params[0] & 0xFFFF);
+		vertex[1] = (int16_t)(params[0] >> 16);
+		vertex[2] = (int16_t)(params[1] & 0xFFFF);
+		int32_t in[4] = {vertex[0], vertex[1], vertex[2], 0x1000};
+		Transform(in, clip, pos_result);
+		break;
+	}
+	case 0x72:
+	{
+		int32_t in[4] = {SignExtend(params[0], 10) << 3, SignExtend(params[0] >> 10, 10) << 3, SignExtend(params[0] >> 20, 10) << 3, 0};
+		int32_t out[4];
+		Transform(in, vector, out);
+		for (int i = 0; i < 3; i++)
+			vec_result[i] = SignExtend(out[i], 16);
+		break;
+	}
+	default:
+		LOG_WARN(GPU, "Unknown geometry command 0x%02x\n", command);
+		break;
+	}
+}
+
+// Runs commands from the packed word that need no parameters, stopping at the next one that does
+void AdvanceFIFO()
+{
+	while (fifo_commands)
+	{
+		uint8_t command = fifo_commands & 0xFF;
+		if (param_counts[command] > 0)
+		{
+			fifo_params = param_counts[command];
+			param_count = 0;
+			return;
+		}
+
+		if (param_counts[command] == 0)
+			Execute(command);
+		fifo_commands >>= 8;
+	}
+	fifo_params = 0;
+}
+
+void WriteGXFIFO(uint32_t data)
+{
+	if (fifo_params == 0)
+	{
+		fifo_commands = data;
+		AdvanceFIFO();
+		return;
+	}
+
+	params[param_count++] = data;
+	if (param_count == fifo_params)
+	{
+		Execute(fifo_commands & 0xFF);
+		fifo_commands >>= 8;
+		AdvanceFIFO();
+	}
+}
+
+void WritePort(uint8_t command, uint32_t data)
+{
+	if (command != port_command)
+	{
+		port_command = command;
+		param_count = 0;
+	}
+
+	if (param_counts[command] == 0)
+	{
+		Execute(command);
+		return;
+	}
+
+	params[param_count++] = data;
+	if (param_count == param_counts[command])
+	{
+		Execute(command);
+		param_count = 0;
+	}
+}
+
+void CheckFIFOInterrupt()
+{
+	// The FIFO is always drained straight away, so it's both empty and less than half full
+	if (((gxstat >> 30) == 1 || (gxstat >> 30) == 2) && !swap_pending)
+		Bus::TriggerInterrupt9(21);
+}
+
+uint32_t ReadGXSTAT()
+{
+	uint32_t value = gxstat & 0xC0000000;
+	value |= box_test_result << 1;
+	value |= (position_sp & 31) << 8;
+	value |= projection_sp << 13;
+	value |= stack_error << 15;
+	if (swap_pending)
+		value |= (std::min<size_t>(halted_commands.size(), 256) << 16) | (1 << 27);
+	else
+		value |= (1 << 25) | (1 << 26);
+	return value;
+}
+
+void GPU3D::Reset()
+{
+	InitParamCounts();
+
+	matrix_mode = 0;
+	projection = position = vector = texture = clip = identity;
+	projection_sp = position_sp = 0;
+	stack_error = false;
+
+	memset(vertex, 0, sizeof(vertex));
+	memset(color, 0, sizeof(color));
+	memset(texcoord, 0, sizeof(texcoord));
+	memset(raw_texcoord, 0, sizeof(raw_texcoord));
+	polygon_attr_pending = polygon_attr = texparam = palette_base = 0;
+	viewport = 0xBFFF0000;
+
+	memset(light_vectors, 0, sizeof(light_vectors));
+	memset(light_colors, 0, sizeof(light_colors));
+	specular_table_enabled = false;
+
+	primitive_type = strip_count = strip_polygons = 0;
+	lists[0].count = lists[0].vertex_count = 0;
+	lists[1].count = lists[1].vertex_count = 0;
+	current_list = 0;
+
+	fifo_commands = 0;
+	fifo_params = param_count = 0;
+	port_command = 0;
+	swap_pending = false;
+	halted_commands.clear();
+
+	disp3dcnt = gxstat = 0;
+	alpha_test_ref = 0;
+	clear_color = clear_depth = 0;
+	fog_color = fog_offset = 0;
+	memset(edge_colors, 0, sizeof(edge_colors));
+	memset(fog_table, 0, sizeof(fog_table));
+	memset(toon_table, 0, sizeof(toon_table));
+}
+
+void GPU3D::VBlank()
+{
+	if (!swap_pending)
+		return;
+
+	GPU3D::PolygonList& list = lists[current_list];
+	list.manual_sort = swap_params & 1;
+
+	GPU3D::RenderState state;
+	state.disp3dcnt = disp3dcnt;
+	state.clear_color = clear_color;
+	state.clear_depth = clear_depth;
+	memcpy(state.edge_colors, edge_colors, sizeof(edge_colors));
+	state.alpha_test_ref = alpha_test_ref;
+	state.fog_color = fog_color;
+	state.fog_offset = fog_offset;
+	memcpy(state.fog_table, fog_table, sizeof(fog_table));
+	memcpy(state.toon_table, toon_table, sizeof(toon_table));
+
+	Renderer::PushRender3D(&list, state);
+
+	// The renderer is done with the other list by now, every VBlank waits for it
+	current_list ^= 1;
+	lists[current_list].count = 0;
+	lists[current_list].vertex_count = 0;
+	lists[current_list].w_buffer = swap_params & 2;
+	swap_pending = false;
+
+	// Run whatever came in while halted, up to the next SWAP_BUFFERS
+	std::vector<uint32_t> commands = std::move(halted_commands);
+	halted_commands.clear();
+	for (size_t i = 0; i < commands.size();)
+	{
+		uint8_t command = commands[i];
+		int count = commands[i + 1];
+		std::copy(&commands[i + 2], &commands[i + 2] + count, params);
+		i += 2 + count;
+		Execute(command);
+	}
+
+	CheckFIFOInterrupt();
+}
+
+template <uint8_t command>
+void WriteCommandPort(uint32_t data, uint32_t)
+{
+	WritePort(command, data);
+}
+
+template <uint8_t... commands>
+void RegisterCommandPorts(std::integer_sequence<uint8_t, commands...>)
+{
+	// Only the command numbers that exist get a port at 0x04000400 + command * 4
+	((param_counts[commands + 0x10] >= 0 ?
+		MMIO::Register(MMIO::CPU9, 0x04000400 + (commands + 0x10) * 4, 4, nullptr, WriteCommandPort<commands + 0x10>) : void()), ...);
+}
+
+template <uint32_t index>
+uint32_t ReadClipMatrix()
+{
+	return clip.m[index / 4][index % 4];
+}
+
+template <uint32_t index>
+uint32_t ReadVectorMatrix()
+{
+	return vector.m[index / 3][index % 3];
+}
+
+template <uint32_t index>
+void WriteEdgeColor(uint32_t data, uint32_t mask)
+{
+	edge_colors[index] = MMIO::Merge(edge_colors[index], data, mask) & 0x7FFF;
+}
+
+template <uint32_t index>
+void WriteFogTable(uint32_t data, uint32_t)
+{
+	fog_table[index] = data & 0x7F;
+}
+
+template <uint32_t index>
+void WriteToonTable(uint32_t data, uint32_t mask)
+{
+	toon_table[index] = MMIO::Merge(toon_table[index], data, mask) & 0x7FFF;
+}
+
+template <uint32_t... index>
+void RegisterTables(std::integer_sequence<uint32_t, index...>)
+{
+	((index < 8 ? MMIO::Register(MMIO::CPU9, 0x04000330 + index * 2, 2, nullptr, WriteEdgeColor<index % 8>) : void()), ...);
+	(MMIO::Register(MMIO::CPU9, 0x04000360 + index, 1, nullptr, WriteFogTable<index>), ...);
+	(MMIO::Register(MMIO::CPU9, 0x04000380 + index * 2, 2, nullptr, WriteToonTable<index>), ...);
+}
+
+template <uint32_t index>
+uint32_t ReadPositionResult()
+{
+	return pos_result[index];
+}
+
+template <uint32_t... index>
+void RegisterMatrixResults(std::integer_sequence<uint32_t, index...>)
+{
+	((index < 4 ? MMIO::Register(MMIO::CPU9, 0x04000620 + index * 4, 4, ReadPositionResult<index % 4>, nullptr) : void()), ...);
+	(MMIO::Register(MMIO::CPU9, 0x04000640 + index * 4, 4, ReadClipMatrix<index>, nullptr), ...);
+	((index < 9 ? MMIO::Register(MMIO::CPU9, 0x04000680 + index * 4, 4, ReadVectorMatrix<index % 9>, nullptr) : void()), ...);
+}
+
+void GPU3D::RegisterMMIO()
+{
+	InitParamCounts();
+
+	MMIO::Register(MMIO::CPU9, 0x04000060, 2, []() -> uint32_t { return disp3dcnt; },
+		[](uint32_t data, uint32_t mask)
+		{
+			// Writing 1 to the underflow and overflow bits acknowledges them
+			uint32_t acknowledge = data & mask & 0x3000;
+			disp3dcnt = (MMIO::Merge(disp3dcnt, data, mask & 0x4FFF)) & ~acknowledge;
+		});
+
+	MMIO::Register(MMIO::CPU9, 0x04000320, 2, []() -> uint32_t { return 46; }, nullptr);
+
+	RegisterTables(std::make_integer_sequence<uint32_t, 32>());
+
+	MMIO::Register(MMIO::CPU9, 0x04000340, 1, nullptr, [](uint32_t data, uint32_t) { alpha_test_ref = data & 0x1F; });
+	MMIO::Register(MMIO::CPU9, 0x04000350, 4, nullptr,
+		[](uint32_t data, uint32_t mask) { clear_color = MMIO::Merge(clear_color, data, mask); });
+	MMIO::Register(MMIO::CPU9, 0x04000354, 2, nullptr,
+		[](uint32_t data, uint32_t mask) { clear_depth = MMIO::Merge(clear_depth, data, mask) & 0x7FFF; });
+	MMIO::Register(MMIO::CPU9, 0x04000356, 2, nullptr, nullptr);
+	MMIO::Register(MMIO::CPU9, 0x04000358, 4, nullptr,
+		[](uint32_t data, uint32_t mask) { fog_color = MMIO::Merge(fog_color, data, mask) & 0x001F7FFF; });
+	MMIO::Register(MMIO::CPU9, 0x0400035C, 2, nullptr,
+		[](uint32_t data, uint32_t mask) { fog_offset = MMIO::Merge(fog_offset, data, mask) & 0x7FFF; });
+
+	MMIO::Register(MMIO::CPU9, 0x04000400, 4, nullptr, [](uint32_t data, uint32_t) { WriteGXFIFO(data); });
+	RegisterCommandPorts(std::make_integer_sequence<uint8_t, 0x73 - 0x10>());
+
+	MMIO::Register(MMIO::CPU9, 0x04000600, 4, ReadGXSTAT,
+		[](uint32_t data, uint32_t mask)
+		{
+			// Bit 15 acknowledges a stack error, only the IRQ mode is writable
+			if (data & mask & (1 << 15))
+			{
+				stack_error = false;
+				projection_sp = 0;
+			}
+			gxstat = MMIO::Merge(gxstat, data, mask & 0xC0000000);
+			CheckFIFOInterrupt();
+		});
+	MMIO::Register(MMIO::CPU9, 0x04000604, 4, []() -> uint32_t
+		{
+			return lists[current_list].count | (lists[current_list].vertex_count << 16);
+		}, nullptr);
+	MMIO::Register(MMIO::CPU9, 0x04000610, 2, nullptr, nullptr);
+
+	MMIO::Register(MMIO::CPU9, 0x04000630, 2, []() -> uint32_t { return (uint16_t)vec_result[0]; }, nullptr);
+	MMIO::Register(MMIO::CPU9, 0x04000632, 2, []() -> uint32_t { return (uint16_t)vec_result[1]; }, nullptr);
+	MMIO::Register(MMIO::CPU9, 0x04000634, 2, []() -> uint32_t { return (uint16_t)vec_result[2]; }, nullptr);
+
+	RegisterMatrixResults(std::make_integer_sequence<uint32_t, 16>());
+}
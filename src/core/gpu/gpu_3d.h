@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+// The geometry engine. Takes commands from GXFIFO and the command ports, keeps the matrix stacks,
+// transforms, lights and clips vertices, and hands the finished polygons to the rasterizer
+// at the VBlank after SWAP_BUFFERS
+namespace GPU3D
+{
+
+constexpr int max_polygons = 2048;
+constexpr int max_vertices = 6144;
+
+// Clipping a quad against all six planes leaves at most ten vertices
+constexpr int max_polygon_vertices = 10;
+
+struct Vertex
+{
+	// Clip coordinates, 20.12 fixed point
+	int32_t x, y, z, w;
+
+	// Pixel position and 24-bit depth, filled in once the polygon has been clipped
+	int32_t screen_x, screen_y;
+	int32_t depth;
+
+	// 5 bits per channel
+	int32_t r, g, b;
+
+	// 12.4 texel coordinates
+	int32_t s, t;
+};
+
+struct Polygon
+{
+	Vertex vertices[max_polygon_vertices];
+	int count;
+
+	uint32_t attr;
+	uint32_t texparam;
+	uint32_t palette_base;
+
+	bool translucent;
+	int top, bottom;
+};
+
+struct PolygonList
+{
+	Polygon polygons[max_polygons];
+	int count;
+	int vertex_count;
+
+	// Parameters of the SWAP_BUFFERS that finished the list
+	bool manual_sort;
+	bool w_buffer;
+};
+
+// Rendering registers as they were when the list was swapped in
+struct RenderState
+{
+	uint32_t disp3dcnt;
+	uint32_t clear_color;
+	uint16_t clear_depth;
+	uint16_t edge_colors[8];
+	uint8_t alpha_test_ref;
+	uint32_t fog_color;
+	uint16_t fog_offset;
+	uint8_t fog_table[32];
+	uint16_t toon_table[32];
+};
+
+void Reset();
+
+void RegisterMMIO();
+
+// Finishes a pending SWAP_BUFFERS, the swapped list is sent to the renderer
+void VBlank();
+
+}
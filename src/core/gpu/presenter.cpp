@@ -0,0 +1,120 @@
+#include "presenter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <src/core/log.h>
+
+constexpr int screen_pixels = Presenter::screen_width * Presenter::screen_height;
+
+Presenter::Backend backend = Presenter::Backend::Headless;
+
+uint16_t last_frame[screen_pixels * 2];
+uint64_t frame_count = 0;
+std::string dump_path;
+
+void Presenter::Init(Backend b)
+{
+	backend = Backend::Headless;
+
+	if (b == Backend::SDL)
+	{
+#ifdef NDS_HAS_SDL
+		if (InitSDL())
+			backend = Backend::SDL;
+		else
+			LOG_WARN(GPU, "Couldn't open an SDL window, running headless\n");
+#else
+		LOG_WARN(GPU, "Built without SDL, running headless\n");
+#endif
+	}
+}
+
+void DumpFrame(const uint16_t* frame)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/frame_%06lu.ppm", frame_count);
+
+	FILE* out = fopen((dump_path + name).c_str(), "wb");
+	if (!out)
+	{
+		LOG_WARN(GPU, "Couldn't write frame to %s\n", dump_path.c_str());
+		return;
+	}
+
+	fprintf(out, "P6\n%d %d\n255\n", Presenter::screen_width, Presenter::screen_height * 2);
+	for (int i = 0; i < screen_pixels * 2; i++)
+	{
+		uint8_t rgb[3] =
+		{
+			(uint8_t)((frame[i] & 0x1F) << 3),
+			(uint8_t)(((frame[i] >> 5) & 0x1F) << 3),
+			(uint8_t)(((frame[i] >> 10) & 0x1F) << 3),
+		};
+		fwrite(rgb, 1, 3, out);
+	}
+
+	fclose(out);
+}
+
+void Presenter::Present(const uint16_t* top, const uint16_t* bottom)
+{
+	static const uint16_t blank_line[screen_width] = {};
+
+	// Only lines that changed since the last frame get copied and uploaded, static screens
+	// then cost next to nothing
+#ifdef NDS_HAS_SDL
+	int first_line = -1;
+	int last_line = -1;
+#endif
+	for (int y = 0; y < screen_height * 2; y++)
+	{
+		const uint16_t* line;
+		if (y < screen_height)
+			line = &top[y * screen_width];
+		else
+			line = bottom ? &bottom[(y - screen_height) * screen_width] : blank_line;
+
+		uint16_t* dst = &last_frame[y * screen_width];
+		if (!memcmp(dst, line, screen_width * 2))
+			continue;
+
+		memcpy(dst, line, screen_width * 2);
+#ifdef NDS_HAS_SDL
+		if (first_line < 0)
+			first_line = y;
+		last_line = y;
+#endif
+	}
+
+	frame_count++;
+
+	switch (backend)
+	{
+	case Backend::SDL:
+#ifdef NDS_HAS_SDL
+		PresentSDL(last_frame, std::max(first_line, 0), first_line < 0 ? 0 : last_line - first_line + 1);
+#endif
+		break;
+	case Backend::Headless:
+		if (!dump_path.empty())
+			DumpFrame(last_frame);
+		break;
+	}
+}
+
+void Presenter::SetFrameDumpPath(const char* dir)
+{
+	dump_path = dir;
+}
+
+const uint16_t* Presenter::GetLastFrame()
+{
+	return last_frame;
+}
+
+uint64_t Presenter::GetFrameCount()
+{
+	return frame_count;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// Where finished frames go. The SDL backend shows them in a window and feeds keyboard input
+// back to the bus, the headless backend keeps them in memory and can write them to disk
+namespace Presenter
+{
+
+constexpr int screen_width = 256;
+constexpr int screen_height = 192;
+
+enum class Backend
+{
+	SDL,
+	Headless,
+};
+
+// Falls back to headless if SDL isn't available
+void Init(Backend backend);
+
+// Frames are 256x192 ABGR1555, a null bottom screen is shown blank
+void Present(const uint16_t* top, const uint16_t* bottom);
+
+// Headless only: writes every presented frame to dir as a PPM
+void SetFrameDumpPath(const char* dir);
+
+// Copy of the last presented frame, both screens stacked top to bottom
+const uint16_t* GetLastFrame();
+uint64_t GetFrameCount();
+
+#ifdef NDS_HAS_SDL
+// Implemented by the SDL backend, frame has both screens stacked. Only line_count lines
+// from first_line on changed since the last frame
+bool InitSDL();
+void PresentSDL(const uint16_t* frame, int first_line, int line_count);
+#endif
+
+}
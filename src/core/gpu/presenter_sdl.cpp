@@ -0,0 +1,86 @@
+#include "presenter.h"
+
+#include <cstdlib>
+#include <SDL2/SDL.h>
+#include <src/core/bus.h>
+
+SDL_Window* window;
+SDL_Renderer* renderer;
+SDL_Texture* tex = nullptr;
+
+bool Presenter::InitSDL()
+{
+	window = SDL_CreateWindow("NDS", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, screen_width, screen_height*2, SDL_WINDOW_SHOWN);
+	if (!window)
+		return false;
+
+	renderer = SDL_CreateRenderer(window, -1, 0);
+	tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR1555, SDL_TEXTUREACCESS_STATIC, screen_width, screen_height*2);
+	return true;
+}
+
+void Presenter::PresentSDL(const uint16_t* frame, int first_line, int line_count)
+{
+	if (line_count)
+	{
+		SDL_Rect rect = {0, first_line, screen_width, line_count};
+		SDL_UpdateTexture(tex, &rect, (const void*)&frame[first_line * screen_width], screen_width*2);
+	}
+	
+	SDL_SetRenderDrawColor(renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
+	SDL_RenderClear(renderer);
+	
+	SDL_RenderCopy(renderer, tex, NULL, NULL);
+	
+	SDL_RenderPresent(renderer);
+
+	SDL_Event event;
+	while (SDL_PollEvent(&event))
+	{
+		switch (event.type)
+		{
+		case SDL_KEYDOWN:
+		{
+			if (event.key.keysym.sym == SDLK_DOWN)
+			{
+				Bus::PressKey(Bus::Keys::KEY_DOWN);
+			}
+			else
+			{
+				Bus::ReleaseKey(Bus::Keys::KEY_DOWN);
+			}
+			if (event.key.keysym.sym == SDLK_UP)
+			{
+				Bus::PressKey(Bus::Keys::KEY_UP);
+			}
+			else
+			{
+				Bus::ReleaseKey(Bus::Keys::KEY_UP);
+			}
+			if (event.key.keysym.sym == SDLK_RETURN)
+			{
+				Bus::PressKey(Bus::Keys::KEY_START);
+			}
+			else
+			{
+				Bus::ReleaseKey(Bus::Keys::KEY_START);
+			}
+			if (event.key.keysym.sym == SDLK_SPACE)
+			{
+				Bus::PressKey(Bus::Keys::KEY_SELECT);
+			}
+			else
+			{
+				Bus::ReleaseKey(Bus::Keys::KEY_SELECT);
+			}
+			break;
+		}
+		case SDL_QUIT:
+			SDL_DestroyRenderer(renderer);
+			SDL_DestroyWindow(window);
+			exit(1);
+			break;
+		}
+	}
+}
+
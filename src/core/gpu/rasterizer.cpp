@@ -0,0 +1,559 @@
+#include "rasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <src/core/gpu/renderer.h>
+
+constexpr int band_height = 24;
+constexpr int band_count = 192 / band_height;
+
+// Per pixel attributes besides colour and depth
+constexpr uint32_t attr_opaque_id = 0x3F;
+constexpr int attr_translucent_id_shift = 8;
+constexpr uint32_t attr_translucent = 1 << 14;
+constexpr uint32_t attr_fog = 1 << 15;
+
+uint32_t color_buffer[256*192];
+int32_t depth_buffer[256*192];
+uint32_t attr_buffer[256*192];
+
+// What the current frame is drawn from, set before the bands are handed out
+const GPU3D::PolygonList* render_list;
+const GPU3D::RenderState* render_state;
+std::vector<int> render_order;
+
+// Worker pool. Each Render hands out bands through next_band until all of them are done
+std::atomic<uint32_t> work_generation = 0;
+std::atomic<int> next_band = band_count;
+std::atomic<int> bands_done = band_count;
+void (*band_function)(int y_start, int y_end);
+bool workers_started = false;
+
+void RunBands()
+{
+	int band;
+	while ((band = next_band.fetch_add(1)) < band_count)
+	{
+		band_function(band * band_height, (band + 1) * band_height);
+		if (bands_done.fetch_add(1) + 1 == band_count)
+			bands_done.notify_all();
+	}
+}
+
+void WorkerThread()
+{
+	uint32_t generation = 0;
+	for (;;)
+	{
+		work_generation.wait(generation);
+		generation = work_generation.load();
+		RunBands();
+	}
+}
+
+// Runs function on every band, the caller takes bands as well, and returns once all are done
+void ForEachBand(void (*function)(int y_start, int y_end))
+{
+	band_function = function;
+	bands_done = 0;
+	next_band = 0;
+	work_generation++;
+	work_generation.notify_all();
+
+	RunBands();
+
+	int done;
+	while ((done = bands_done.load()) != band_count)
+		bands_done.wait(done);
+}
+
+void Rasterizer::StartWorkers()
+{
+	if (workers_started)
+		return;
+	workers_started = true;
+
+	// Leave a core each for the emulation and render threads
+	int count = std::clamp((int)std::thread::hardware_concurrency() - 2, 0, band_count - 1);
+	for (int i = 0; i < count; i++)
+		std::thread(WorkerThread).detach();
+}
+
+uint16_t ReadPalette(uint32_t addr)
+{
+	uint8_t* ptr = Renderer::MapTexturePalette(addr);
+	return ptr ? *(uint16_t*)ptr : 0;
+}
+
+uint8_t ReadTexture8(uint32_t addr)
+{
+	uint8_t* ptr = Renderer::MapTexture(addr);
+	return ptr ? *ptr : 0;
+}
+
+uint16_t ReadTexture16(uint32_t addr)
+{
+	uint8_t* ptr = Renderer::MapTexture(addr);
+	return ptr ? *(uint16_t*)ptr : 0;
+}
+
+// Repeats, mirrors or clamps a texel coordinate into 0..size-1
+int WrapCoordinate(int coord, int size, bool repeat, bool flip)
+{
+	if (!repeat)
+		return std::clamp(coord, 0, size - 1);
+	if (flip && (coord & size))
+		return size - 1 - (coord & (size - 1));
+	return coord & (size - 1);
+}
+
+uint16_t MixColors(uint16_t a, uint16_t b, int weight_a, int weight_b, int shift)
+{
+	uint16_t result = 0;
+	for (int i = 0; i < 15; i += 5)
+		result |= ((((a >> i) & 0x1F) * weight_a + ((b >> i) & 0x1F) * weight_b) >> shift) << i;
+	return result;
+}
+
+// Colour in bits 0-14 and alpha in bits 16-20, alpha 0 is a transparent texel
+uint32_t SampleTexture(uint32_t texparam, uint32_t palette_base, int s, int t)
+{
+	int width = 8 << ((texparam >> 20) & 7);
+	int height = 8 << ((texparam >> 23) & 7);
+	s = WrapCoordinate(s, width, texparam & (1 << 16), texparam & (1 << 18));
+	t = WrapCoordinate(t, height, texparam & (1 << 17), texparam & (1 << 19));
+
+	uint32_t addr = (texparam & 0xFFFF) * 8;
+	bool transparent_zero = texparam & (1 << 29);
+	uint32_t texel = t * width + s;
+
+	switch ((texparam >> 26) & 7)
+	{
+	case 1:
+	{
+		uint8_t data = ReadTexture8(addr + texel);
+		int alpha = data >> 5;
+		return ReadPalette(palette_base * 16 + (data & 0x1F) * 2) | ((alpha * 4 + alpha / 2) << 16);
+	}
+	case 2:
+	{
+		int index = (ReadTexture8(addr + texel / 4) >> ((texel & 3) * 2)) & 3;
+		if (transparent_zero && index == 0)
+			return 0;
+		return ReadPalette(palette_base * 8 + index * 2) | (31 << 16);
+	}
+	case 3:
+	{
+		int index = (ReadTexture8(addr + texel / 2) >> ((texel & 1) * 4)) & 0xF;
+		if (transparent_zero && index == 0)
+			return 0;
+		return ReadPalette(palette_base * 16 + index * 2) | (31 << 16);
+	}
+	case 4:
+	{
+		int index = ReadTexture8(addr + texel);
+		if (transparent_zero && index == 0)
+			return 0;
+		return ReadPalette(palette_base * 16 + index * 2) | (31 << 16);
+	}
+	case 5:
+	{
+		// 4x4 blocks of 2-bit texels, each block's palette info lives in slot 1
+		uint32_t block = (t / 4) * (width / 4) + s / 4;
+		uint32_t data = ReadTexture8(addr + block * 4 + (t & 3));
+		int index = (data >> ((s & 3) * 2)) & 3;
+
+		uint32_t info_addr = 0x20000 + (addr & 0x1FFFF) / 2 + ((addr >= 0x40000) ? 0x10000 : 0) + block * 2;
+		uint16_t info = ReadTexture16(info_addr);
+		uint32_t palette = palette_base * 16 + (info & 0x3FFF) * 4;
+		int mode = info >> 14;
+
+		uint16_t c0 = ReadPalette(palette);
+		uint16_t c1 = ReadPalette(palette + 2);
+
+		switch (index)
+		{
+		case 0:
+			return c0 | (31 << 16);
+		case 1:
+			return c1 | (31 << 16);
+		case 2:
+			if (mode == 1)
+				return MixColors(c0, c1, 1, 1, 1) | (31 << 16);
+			if (mode == 3)
+				return MixColors(c0, c1, 5, 3, 3) | (31 << 16);
+			return ReadPalette(palette + 4) | (31 << 16);
+		default:
+			if (mode == 2)
+				return ReadPalette(palette + 6) | (31 << 16);
+			if (mode == 3)
+				return MixColors(c0, c1, 3, 5, 3) | (31 << 16);
+			return 0;
+		}
+	}
+	case 6:
+	{
+		uint8_t data = ReadTexture8(addr + texel);
+		return ReadPalette(palette_base * 16 + (data & 7) * 2) | ((data >> 3) << 16);
+	}
+	case 7:
+	{
+		uint16_t data = ReadTexture16(addr + texel * 2);
+		return (data & 0x7FFF) | ((data & 0x8000) ? (31 << 16) : 0);
+	}
+	default:
+		return 0;
+	}
+}
+
+// Attributes interpolated across a polygon. Everything but depth is divided by w so it can be
+// interpolated linearly in screen space
+struct Point
+{
+	float x;
+	float inv_w;
+	float depth;
+	float r, g, b, s, t;
+};
+
+Point Lerp(const Point& a, const Point& b, float f)
+{
+	Point p;
+	p.x = a.x + (b.x - a.x) * f;
+	p.inv_w = a.inv_w + (b.inv_w - a.inv_w) * f;
+	p.depth = a.depth + (b.depth - a.depth) * f;
+	p.r = a.r + (b.r - a.r) * f;
+	p.g = a.g + (b.g - a.g) * f;
+	p.b = a.b + (b.b - a.b) * f;
+	p.s = a.s + (b.s - a.s) * f;
+	p.t = a.t + (b.t - a.t) * f;
+	return p;
+}
+
+Point MakePoint(const GPU3D::Vertex& v)
+{
+	float inv_w = 4096.0f / std::max(v.w, 1);
+	return {(float)v.screen_x, inv_w, (float)v.depth, v.r * inv_w, v.g * inv_w, v.b * inv_w, v.s * inv_w, v.t * inv_w};
+}
+
+void DrawPixel(const GPU3D::Polygon& polygon, int x, int y, const Point& p, bool w_buffer)
+{
+	const GPU3D::RenderState& state = *render_state;
+	int index = y * 256 + x;
+	uint32_t attr = polygon.attr;
+
+	float w = 1.0f / p.inv_w;
+	int32_t depth = w_buffer ? (int32_t)std::min(w * 4096.0f, (float)0xFFFFFF) : (int32_t)p.depth;
+
+	bool equal_test = attr & (1 << 14);
+	if (equal_test ? std::abs(depth - depth_buffer[index]) > 0x200 : depth >= depth_buffer[index])
+		return;
+
+	int r = std::clamp((int)(p.r * w), 0, 31);
+	int g = std::clamp((int)(p.g * w), 0, 31);
+	int b = std::clamp((int)(p.b * w), 0, 31);
+	int alpha = (attr >> 16) & 0x1F;
+
+	// Wireframe polygons only get their outline, at full opacity
+	if (alpha == 0)
+		alpha = 31;
+
+	int mode = (attr >> 4) & 3;
+	if (mode == 2)
+	{
+		uint16_t toon = state.toon_table[r];
+		if (state.disp3dcnt & (1 << 1))
+			g = b = r;
+		else
+		{
+			r = toon & 0x1F;
+			g = (toon >> 5) & 0x1F;
+			b = (toon >> 10) & 0x1F;
+		}
+	}
+
+	if ((state.disp3dcnt & 1) && ((polygon.texparam >> 26) & 7))
+	{
+		uint32_t texel = SampleTexture(polygon.texparam, polygon.palette_base, (int)(p.s * w) >> 4, (int)(p.t * w) >> 4);
+		int tr = texel & 0x1F;
+		int tg = (texel >> 5) & 0x1F;
+		int tb = (texel >> 10) & 0x1F;
+		int ta = (texel >> 16) & 0x1F;
+
+		if (mode == 1)
+		{
+			r = (tr * ta + r * (31 - ta)) / 31;
+			g = (tg * ta + g * (31 - ta)) / 31;
+			b = (tb * ta + b * (31 - ta)) / 31;
+		}
+		else
+		{
+			r = ((tr + 1) * (r + 1) - 1) >> 5;
+			g = ((tg + 1) * (g + 1) - 1) >> 5;
+			b = ((tb + 1) * (b + 1) - 1) >> 5;
+			alpha = ((ta + 1) * (alpha + 1) - 1) >> 5;
+		}
+	}
+
+	if (mode == 2 && (state.disp3dcnt & (1 << 1)))
+	{
+		uint16_t toon = state.toon_table[r];
+		r = std::min(31, r + (toon & 0x1F));
+		g = std::min(31, g + ((toon >> 5) & 0x1F));
+		b = std::min(31, b + ((toon >> 10) & 0x1F));
+	}
+
+	if (alpha == 0)
+		return;
+	if ((state.disp3dcnt & (1 << 2)) && alpha <= state.alpha_test_ref)
+		return;
+
+	uint32_t id = (attr >> 24) & 0x3F;
+	uint32_t color = r | (g << 5) | (b << 10);
+	uint32_t& dst_attr = attr_buffer[index];
+
+	if (alpha < 31)
+	{
+		// A translucent polygon never draws over its own pixels twice
+		if ((dst_attr & attr_translucent) && ((dst_attr >> attr_translucent_id_shift) & 0x3F) == id)
+			return;
+
+		uint32_t dst = color_buffer[index];
+		int dst_alpha = (dst >> 16) & 0x1F;
+		if ((state.disp3dcnt & (1 << 3)) && dst_alpha)
+		{
+			color = MixColors(color, dst & 0x7FFF, alpha + 1, 31 - alpha, 5);
+			alpha = std::max(alpha, dst_alpha);
+		}
+
+		color_buffer[index] = color | (alpha << 16);
+		dst_attr = (dst_attr & attr_opaque_id) | (id << attr_translucent_id_shift) | attr_translucent
+			| ((attr & (1 << 15)) ? (dst_attr & attr_fog) : 0);
+		if (attr & (1 << 11))
+			depth_buffer[index] = depth;
+		return;
+	}
+
+	color_buffer[index] = color | (31 << 16);
+	depth_buffer[index] = depth;
+	dst_attr = id | ((attr & (1 << 15)) ? attr_fog : 0);
+}
+
+void DrawPolygon(const GPU3D::Polygon& polygon, int y_start, int y_end)
+{
+	// Shadow polygons need the stencil buffer, which isn't there yet
+	if (((polygon.attr >> 4) & 3) == 3)
+		return;
+
+	y_start = std::max(y_start, polygon.top);
+	y_end = std::min(y_end, polygon.bottom + 1);
+
+	bool wireframe = ((polygon.attr >> 16) & 0x1F) == 0;
+	Point points[GPU3D::max_polygon_vertices];
+	for (int i = 0; i < polygon.count; i++)
+		points[i] = MakePoint(polygon.vertices[i]);
+
+	for (int y = y_start; y < y_end; y++)
+	{
+		float center = y + 0.5f;
+		Point left, right;
+		bool found = false;
+
+		// Convex, so every scanline crosses the outline at most twice
+		for (int i = 0; i < polygon.count; i++)
+		{
+			const GPU3D::Vertex& a = polygon.vertices[i];
+			const GPU3D::Vertex& b = polygon.vertices[(i + 1) % polygon.count];
+			if (a.screen_y == b.screen_y)
+				continue;
+
+			int top = std::min(a.screen_y, b.screen_y);
+			int bottom = std::max(a.screen_y, b.screen_y);
+			if (center < top || center >= bottom)
+				continue;
+
+			Point p = Lerp(points[i], points[(i + 1) % polygon.count], (center - a.screen_y) / (float)(b.screen_y - a.screen_y));
+			if (!found)
+			{
+				left = right = p;
+				found = true;
+			}
+			else if (p.x < left.x)
+				left = p;
+			else if (p.x > right.x)
+				right = p;
+		}
+
+		// Flat polygons still get a line, that's how the hardware draws lines
+		if (!found)
+		{
+			if (polygon.top != polygon.bottom || y != polygon.top)
+				continue;
+			left = right = points[0];
+			for (int i = 1; i < polygon.count; i++)
+			{
+				if (points[i].x < left.x)
+					left = points[i];
+				if (points[i].x > right.x)
+					right = points[i];
+			}
+		}
+
+		int x_start = std::max(0, (int)std::ceil(left.x - 0.5f));
+		int x_end = std::min(256, (int)std::ceil(right.x - 0.5f));
+		if (x_end <= x_start && x_start < 256)
+			x_end = x_start + 1;
+
+		float width = right.x - left.x;
+		bool edge_line = y == polygon.top || y == polygon.bottom;
+
+		for (int x = x_start; x < x_end; x++)
+		{
+			if (wireframe && !edge_line && x != x_start && x != x_end - 1)
+				continue;
+
+			float f = width > 0 ? std::clamp((x + 0.5f - left.x) / width, 0.0f, 1.0f) : 0.0f;
+			DrawPixel(polygon, x, y, Lerp(left, right, f), render_list->w_buffer);
+		}
+	}
+}
+
+void RasterizeBand(int y_start, int y_end)
+{
+	const GPU3D::RenderState& state = *render_state;
+
+	int32_t clear_depth = state.clear_depth * 0x200 + ((state.clear_depth + 1) / 0x8000) * 0x1FF;
+	uint32_t clear_color = (state.clear_color & 0x7FFF) | (((state.clear_color >> 16) & 0x1F) << 16);
+	uint32_t clear_attr = ((state.clear_color >> 24) & 0x3F) | ((state.clear_color & (1 << 15)) ? attr_fog : 0);
+
+	std::fill(&color_buffer[y_start * 256], &color_buffer[y_end * 256], clear_color);
+	std::fill(&depth_buffer[y_start * 256], &depth_buffer[y_end * 256], clear_depth);
+	std::fill(&attr_buffer[y_start * 256], &attr_buffer[y_end * 256], clear_attr);
+
+	for (int index : render_order)
+	{
+		const GPU3D::Polygon& polygon = render_list->polygons[index];
+		if (polygon.bottom >= y_start && polygon.top < y_end)
+			DrawPolygon(polygon, y_start, y_end);
+	}
+}
+
+// Edge marking and fog, both need the whole frame's depth and polygon IDs around a pixel
+void FinishBand(int y_start, int y_end)
+{
+	const GPU3D::RenderState& state = *render_state;
+
+	if (state.disp3dcnt & (1 << 5))
+	{
+		for (int y = y_start; y < y_end; y++)
+		{
+			for (int x = 0; x < 256; x++)
+			{
+				int index = y * 256 + x;
+				if (!(color_buffer[index] >> 16) || (attr_buffer[index] & attr_translucent))
+					continue;
+
+				uint32_t id = attr_buffer[index] & attr_opaque_id;
+				int32_t depth = depth_buffer[index];
+				bool edge = false;
+
+				const int neighbours[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+				for (auto [dx, dy] : neighbours)
+				{
+					int nx = x + dx, ny = y + dy;
+					if (nx < 0 || nx > 255 || ny < 0 || ny > 191)
+						continue;
+					int n = ny * 256 + nx;
+					if ((attr_buffer[n] & attr_opaque_id) != id && depth < depth_buffer[n])
+						edge = true;
+				}
+
+				if (edge)
+					color_buffer[index] = (color_buffer[index] & 0xFFFF0000) | state.edge_colors[id >> 3];
+			}
+		}
+	}
+
+	if (state.disp3dcnt & (1 << 7))
+	{
+		int shift = (state.disp3dcnt >> 8) & 0xF;
+		float step = (float)(0x400 >> shift);
+		bool alpha_only = state.disp3dcnt & (1 << 6);
+
+		for (int i = y_start * 256; i < y_end * 256; i++)
+		{
+			if (!(attr_buffer[i] & attr_fog))
+				continue;
+
+			// Entry n of the table is the density at fog_offset + (n + 1) * step
+			float position = ((depth_buffer[i] >> 9) - state.fog_offset) / step - 1;
+			int density;
+			if (position <= 0)
+				density = state.fog_table[0];
+			else if (position >= 31)
+				density = state.fog_table[31];
+			else
+			{
+				int n = (int)position;
+				float f = position - n;
+				density = (int)(state.fog_table[n] * (1 - f) + state.fog_table[n + 1] * f);
+			}
+			if (density == 127)
+				density = 128;
+
+			uint32_t pixel = color_buffer[i];
+			int alpha = (pixel >> 16) & 0x1F;
+			int fog_alpha = (state.fog_color >> 16) & 0x1F;
+			alpha = (fog_alpha * density + alpha * (128 - density)) >> 7;
+
+			uint32_t color = pixel & 0x7FFF;
+			if (!alpha_only)
+				color = MixColors(state.fog_color & 0x7FFF, color, density, 128 - density, 7);
+
+			color_buffer[i] = color | (alpha << 16);
+		}
+	}
+}
+
+void Rasterizer::Render(const GPU3D::PolygonList& list, const GPU3D::RenderState& state)
+{
+	render_list = &list;
+	render_state = &state;
+
+	// Opaque polygons first in the order they came in, then the translucent ones sorted by
+	// their top edge unless the game asked to keep its own order
+	render_order.clear();
+	for (int i = 0; i < list.count; i++)
+	{
+		if (!list.polygons[i].translucent)
+			render_order.push_back(i);
+	}
+
+	size_t opaque_count = render_order.size();
+	for (int i = 0; i < list.count; i++)
+	{
+		if (list.polygons[i].translucent)
+			render_order.push_back(i);
+	}
+
+	if (!list.manual_sort)
+	{
+		std::stable_sort(render_order.begin() + opaque_count, render_order.end(), [&](int a, int b)
+		{
+			const GPU3D::Polygon& pa = list.polygons[a];
+			const GPU3D::Polygon& pb = list.polygons[b];
+			return pa.bottom != pb.bottom ? pa.bottom < pb.bottom : pa.top < pb.top;
+		});
+	}
+
+	ForEachBand(RasterizeBand);
+	ForEachBand(FinishBand);
+}
+
+const uint32_t* Rasterizer::GetLine(int y)
+{
+	return &color_buffer[y * 256];
+}
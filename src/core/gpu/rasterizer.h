@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <src/core/gpu/gpu_3d.h>
+
+// Software rasterizer for the 3D engine. The screen is split into horizontal bands that a pool
+// of worker threads draws in parallel, each band going through every polygon on its own
+namespace Rasterizer
+{
+
+// Starts the worker threads. Until then every band is drawn by the caller of Render
+void StartWorkers();
+
+// Draws a swapped polygon list. Textures come from the renderer's copy of VRAM
+void Render(const GPU3D::PolygonList& list, const GPU3D::RenderState& state);
+
+// 256 pixels of the last frame, colour in bits 0-14 and alpha in bits 16-20. Alpha 0 is
+// a pixel nothing was drawn on
+const uint32_t* GetLine(int y);
+
+}
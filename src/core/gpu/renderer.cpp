@@ -0,0 +1,218 @@
+#include <src/core/gpu/renderer.h>
+#include <src/core/gpu/gpu.h>
+#include <src/core/gpu/rasterizer.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+struct Job
+{
+	enum Type : uint8_t
+	{
+		Line,
+		Memory,
+		Mapping,
+		Render3D,
+	} type;
+
+	int y;
+	uint32_t offset;
+	const GPU3D::PolygonList* list;
+
+	union
+	{
+		Engine2D::Registers registers[2];
+		uint8_t data[Renderer::chunk_size];
+		uint8_t vramcnt[GPU::vram_bank_count];
+		GPU3D::RenderState state;
+	};
+};
+
+// Single producer, single consumer. The indices only ever grow, the slot is index % queue_size
+constexpr uint32_t queue_size = 1024;
+Job jobs[queue_size];
+std::atomic<uint32_t> write_index = 0;
+std::atomic<uint32_t> read_index = 0;
+
+bool render_threaded = false;
+
+// Everything below belongs to the render thread once it's running
+uint8_t render_memory[GPU::video_memory_size];
+GPU::VRAMMap render_map;
+
+// Bumped whenever render_memory, the mapping or the 3D output actually change, lines drawn
+// at the same version from the same registers come out the same
+uint32_t memory_version = 0;
+
+Engine2D render_a(true, &render_memory[GPU::palette_offset], &render_memory[GPU::oam_offset], 0x06000000, 0x06400000);
+Engine2D render_b(false, &render_memory[GPU::palette_offset + 0x400], &render_memory[GPU::oam_offset + 0x400], 0x06200000, 0x06600000);
+
+uint16_t frame_a[256*192];
+uint16_t frame_b[256*192];
+
+void ProcessJob(const Job& job)
+{
+	switch (job.type)
+	{
+	case Job::Line:
+		render_a.RenderLine(job.y, job.registers[0], Rasterizer::GetLine(job.y), memory_version, &frame_a[job.y * 256]);
+		render_b.RenderLine(job.y, job.registers[1], nullptr, memory_version, &frame_b[job.y * 256]);
+		break;
+	case Job::Memory:
+		// Games rewrite OAM and palettes every frame whether they changed or not
+		if (memcmp(&render_memory[job.offset], job.data, Renderer::chunk_size))
+		{
+			memcpy(&render_memory[job.offset], job.data, Renderer::chunk_size);
+			memory_version++;
+		}
+		break;
+	case Job::Mapping:
+		GPU::BuildVRAMMap(job.vramcnt, render_memory, render_map);
+		memory_version++;
+		break;
+	case Job::Render3D:
+		Rasterizer::Render(*job.list, job.state);
+		memory_version++;
+		break;
+	}
+}
+
+void RenderThread()
+{
+	for (;;)
+	{
+		uint32_t index = read_index.load(std::memory_order_relaxed);
+		write_index.wait(index, std::memory_order_acquire);
+
+		ProcessJob(jobs[index % queue_size]);
+
+		read_index.store(index + 1, std::memory_order_release);
+		read_index.notify_one();
+	}
+}
+
+Job& BeginPush()
+{
+	uint32_t index = write_index.load(std::memory_order_relaxed);
+
+	// Full, wait for the render thread to catch up
+	uint32_t read;
+	while (index - (read = read_index.load(std::memory_order_acquire)) == queue_size)
+		read_index.wait(read, std::memory_order_acquire);
+
+	return jobs[index % queue_size];
+}
+
+void EndPush()
+{
+	uint32_t index = write_index.load(std::memory_order_relaxed);
+
+	if (!render_threaded)
+	{
+		ProcessJob(jobs[index % queue_size]);
+		read_index.store(index + 1, std::memory_order_relaxed);
+	}
+
+	write_index.store(index + 1, std::memory_order_release);
+	write_index.notify_one();
+}
+
+void WaitForIdle()
+{
+	uint32_t index = write_index.load(std::memory_order_relaxed);
+
+	uint32_t read;
+	while ((read = read_index.load(std::memory_order_acquire)) != index)
+		read_index.wait(read, std::memory_order_acquire);
+}
+
+void Renderer::StartThread()
+{
+	if (render_threaded)
+		return;
+
+	render_threaded = true;
+	// Never joined, the emulator only stops by exiting
+	std::thread(RenderThread).detach();
+	Rasterizer::StartWorkers();
+}
+
+void Renderer::Reset()
+{
+	WaitForIdle();
+	memset(render_memory, 0, sizeof(render_memory));
+	memset(&render_map, 0, sizeof(render_map));
+	memory_version++;
+}
+
+void Renderer::PushLine(int y, const Engine2D::Registers& a, const Engine2D::Registers& b)
+{
+	Job& job = BeginPush();
+	job.type = Job::Line;
+	job.y = y;
+	job.registers[0] = a;
+	job.registers[1] = b;
+	EndPush();
+}
+
+void Renderer::PushMemory(uint32_t offset, const uint8_t* data)
+{
+	Job& job = BeginPush();
+	job.type = Job::Memory;
+	job.offset = offset;
+	memcpy(job.data, data, Renderer::chunk_size);
+	EndPush();
+}
+
+void Renderer::PushMapping(const uint8_t* vramcnt)
+{
+	Job& job = BeginPush();
+	job.type = Job::Mapping;
+	memcpy(job.vramcnt, vramcnt, sizeof(job.vramcnt));
+	EndPush();
+}
+
+void Renderer::PushRender3D(const GPU3D::PolygonList* list, const GPU3D::RenderState& state)
+{
+	Job& job = BeginPush();
+	job.type = Job::Render3D;
+	job.list = list;
+	job.state = state;
+	EndPush();
+}
+
+void Renderer::FinishFrame(const uint16_t** a, const uint16_t** b)
+{
+	WaitForIdle();
+	*a = frame_a;
+	*b = frame_b;
+}
+
+uint8_t* Renderer::MapVRAM(uint32_t addr)
+{
+	uint8_t* page = render_map.arm9[(addr & 0xFFFFFF) >> GPU::vram_page_shift];
+	return page ? page + (addr & ((1 << GPU::vram_page_shift) - 1)) : nullptr;
+}
+
+uint8_t* Renderer::MapTexture(uint32_t offset)
+{
+	uint8_t* page = render_map.texture[(offset >> GPU::vram_page_shift) % GPU::texture_page_count];
+	return page ? page + (offset & ((1 << GPU::vram_page_shift) - 1)) : nullptr;
+}
+
+uint8_t* Renderer::MapTexturePalette(uint32_t offset)
+{
+	uint8_t* page = render_map.texture_palette[(offset >> GPU::vram_page_shift) % GPU::texture_palette_page_count];
+	return page ? page + (offset & ((1 << GPU::vram_page_shift) - 1)) : nullptr;
+}
+
+uint8_t* Renderer::MapBGExtPalette(bool is_engine_a, int slot)
+{
+	return render_map.bg_ext_palette[!is_engine_a][slot];
+}
+
+uint8_t* Renderer::MapOBJExtPalette(bool is_engine_a)
+{
+	return render_map.obj_ext_palette[!is_engine_a];
+}
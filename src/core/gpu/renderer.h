@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <src/core/gpu/engine_2d.h>
+#include <src/core/gpu/gpu_3d.h>
+
+// Runs both 2D engines off the emulation thread. The GPU pushes a copy of the engine registers
+// for every visible line, along with any video memory written since the previous line, and
+// the render thread draws from its own copy of video memory while the CPUs carry on
+namespace Renderer
+{
+
+// 1 KiB pieces of video memory are sent over as they get written
+constexpr uint32_t chunk_size = 0x400;
+
+// Until this is called every job is done as soon as it's pushed, on the calling thread
+void StartThread();
+
+// Waits for anything in flight and clears the renderer's copy of video memory
+void Reset();
+
+void PushLine(int y, const Engine2D::Registers& a, const Engine2D::Registers& b);
+void PushMemory(uint32_t offset, const uint8_t* data);
+void PushMapping(const uint8_t* vramcnt);
+
+// The list has to stay untouched until the next FinishFrame, the state is copied
+void PushRender3D(const GPU3D::PolygonList* list, const GPU3D::RenderState& state);
+
+// Waits for every line pushed so far, then hands back what engine A and B drew
+void FinishFrame(const uint16_t** a, const uint16_t** b);
+
+// Render thread only: host pointer for an ARM9 VRAM address in the renderer's copy
+uint8_t* MapVRAM(uint32_t addr);
+
+// Render thread only: host pointers for offsets into texture and texture palette memory
+uint8_t* MapTexture(uint32_t offset);
+uint8_t* MapTexturePalette(uint32_t offset);
+
+// Render thread only: an engine's 8 KiB extended palette slots, null when nothing is mapped
+uint8_t* MapBGExtPalette(bool is_engine_a, int slot);
+uint8_t* MapOBJExtPalette(bool is_engine_a);
+
+}
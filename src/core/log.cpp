@@ -0,0 +1,91 @@
+#include "log.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+const char* category_names[] =
+{
+	"Bus",
+	"MMIO",
+	"IRQ",
+	"IPC",
+	"Cart",
+	"SPI",
+	"RTC",
+	"GPU",
+	"CP15",
+	"CPU",
+	"JIT",
+	"DMA",
+};
+
+struct Entry
+{
+	Log::Category category;
+	char text[124];
+};
+
+constexpr uint32_t ring_size = 4096;
+
+Entry ring[ring_size];
+
+// Writers claim a slot with a single fetch_add and overwrite the oldest entry when it wraps
+std::atomic<uint32_t> ring_head = 0;
+bool use_ring = false;
+
+void Log::Write(Category category, Level level, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+
+	if (use_ring)
+	{
+		Entry& e = ring[ring_head.fetch_add(1, std::memory_order_relaxed) & (ring_size - 1)];
+		e.category = category;
+
+		va_list copy;
+		va_copy(copy, args);
+		vsnprintf(e.text, sizeof(e.text), fmt, copy);
+		va_end(copy);
+
+		if (level == Level::Error)
+		{
+			fprintf(stderr, "[emu/%s]: ", category_names[(int)category]);
+			vfprintf(stderr, fmt, args);
+		}
+	}
+	else
+	{
+		printf("[emu/%s]: ", category_names[(int)category]);
+		vprintf(fmt, args);
+	}
+
+	va_end(args);
+}
+
+void Log::EnableRing()
+{
+	use_ring = true;
+}
+
+void Log::DumpRing(const char* path)
+{
+	if (!use_ring)
+		return;
+
+	FILE* out = fopen(path, "w");
+	if (!out)
+		return;
+
+	uint32_t head = ring_head.load();
+	uint32_t start = head > ring_size ? head - ring_size : 0;
+
+	for (uint32_t i = start; i < head; i++)
+	{
+		const Entry& e = ring[i & (ring_size - 1)];
+		fprintf(out, "[emu/%s]: %s", category_names[(int)e.category], e.text);
+	}
+
+	fclose(out);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+// Levels are fixed at compile time with NDS_LOG_LEVEL, anything above it compiles to nothing
+#ifndef NDS_LOG_LEVEL
+#define NDS_LOG_LEVEL 2
+#endif
+
+namespace Log
+{
+
+enum class Level
+{
+	Off,
+	Error,
+	Warn,
+	Info,
+	Debug,
+	Trace,
+};
+
+enum class Category
+{
+	Bus,
+	MMIO,
+	IRQ,
+	IPC,
+	Cart,
+	SPI,
+	RTC,
+	GPU,
+	CP15,
+	CPU,
+	JIT,
+	DMA,
+};
+
+constexpr Level max_level = (Level)NDS_LOG_LEVEL;
+
+constexpr bool Enabled(Level level)
+{
+	return level <= max_level;
+}
+
+void Write(Category category, Level level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+// Sends messages to an in-memory ring instead of stdout, so tracing doesn't stall on stdio.
+// Errors still go to stderr as well
+void EnableRing();
+
+// Writes whatever is in the ring, oldest first
+void DumpRing(const char* path);
+
+}
+
+#define LOG(level, category, ...) \
+	do \
+	{ \
+		if constexpr (Log::Enabled(Log::Level::level)) \
+			Log::Write(Log::Category::category, Log::Level::level, __VA_ARGS__); \
+	} while (0)
+
+#define LOG_ERROR(category, ...) LOG(Error, category, __VA_ARGS__)
+#define LOG_WARN(category, ...) LOG(Warn, category, __VA_ARGS__)
+#define LOG_INFO(category, ...) LOG(Info, category, __VA_ARGS__)
+#define LOG_DEBUG(category, ...) LOG(Debug, category, __VA_ARGS__)
+#define LOG_TRACE(category, ...) LOG(Trace, category, __VA_ARGS__)
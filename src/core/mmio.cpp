@@ -0,0 +1,138 @@
+#include "mmio.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <src/core/log.h>
+
+struct Handler
+{
+	uint32_t addr;
+	int size;
+	MMIO::ReadFn read;
+	MMIO::WriteFn write;
+};
+
+// The registers live at 0x04000000-0x04001FFF, plus the IPC FIFO and cartridge data ports at 0x04100000
+constexpr uint32_t io_size = 0x2000;
+constexpr uint32_t port_size = 0x20;
+
+struct Space
+{
+	std::vector<Handler> handlers;
+	// 1-based index into handlers for every byte, 0 if nothing is registered there
+	uint16_t map[io_size + port_size];
+} spaces[2];
+
+int Offset(uint32_t addr)
+{
+	if (addr - 0x04000000 < io_size)
+		return addr - 0x04000000;
+	if (addr - 0x04100000 < port_size)
+		return io_size + addr - 0x04100000;
+	return -1;
+}
+
+const Handler* Lookup(const Space& space, uint32_t addr)
+{
+	int offset = Offset(addr);
+	if (offset < 0 || !space.map[offset])
+		return nullptr;
+	return &space.handlers[space.map[offset] - 1];
+}
+
+uint32_t ByteMask(int bytes)
+{
+	return 0xFFFFFFFFull >> (32 - bytes * 8);
+}
+
+void MMIO::Register(uint8_t cpus, uint32_t addr, int size, ReadFn read, WriteFn write)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if (!(cpus & (1 << i)))
+			continue;
+
+		Space& space = spaces[i];
+		space.handlers.push_back({addr, size, read, write});
+
+		for (int j = 0; j < size; j++)
+			space.map[Offset(addr + j)] = space.handlers.size();
+	}
+}
+
+uint32_t MMIO::Read(bool is_arm9, uint32_t addr, int size)
+{
+	const Space& space = spaces[!is_arm9];
+	const Handler* h = Lookup(space, addr);
+
+	if (h && h->addr == addr && h->size == size)
+		return h->read ? h->read() : 0;
+
+	// Bytes nobody registered read as 0, unless the access hit nothing at all
+	uint32_t value = 0;
+	bool found = false;
+	for (int i = 0; i < size;)
+	{
+		h = Lookup(space, addr + i);
+		if (!h)
+		{
+			i++;
+			continue;
+		}
+
+		int offset = addr + i - h->addr;
+		int bytes = std::min(h->size - offset, size - i);
+		uint32_t part = h->read ? h->read() >> (offset * 8) : 0;
+		value |= (part & ByteMask(bytes)) << (i * 8);
+		i += bytes;
+		found = true;
+	}
+
+	if (!found)
+	{
+		LOG_ERROR(MMIO, "Read%d from unknown %s register 0x%08x\n", size * 8, is_arm9 ? "ARM9" : "ARM7", addr);
+		exit(1);
+	}
+
+	return value;
+}
+
+void MMIO::Write(bool is_arm9, uint32_t addr, uint32_t data, int size)
+{
+	const Space& space = spaces[!is_arm9];
+	const Handler* h = Lookup(space, addr);
+
+	if (h && h->addr == addr && h->size == size)
+	{
+		if (h->write)
+			h->write(data, ByteMask(size));
+		return;
+	}
+
+	bool found = false;
+	for (int i = 0; i < size;)
+	{
+		h = Lookup(space, addr + i);
+		if (!h)
+		{
+			i++;
+			continue;
+		}
+
+		int offset = addr + i - h->addr;
+		int bytes = std::min(h->size - offset, size - i);
+		if (h->write)
+			h->write(((data >> (i * 8)) & ByteMask(bytes)) << (offset * 8), ByteMask(bytes) << (offset * 8));
+		i += bytes;
+		found = true;
+	}
+
+	if (!found)
+	{
+		LOG_ERROR(MMIO, "Write%d 0x%08x to unknown %s register 0x%08x\n", size * 8, data, is_arm9 ? "ARM9" : "ARM7", addr);
+		exit(1);
+	}
+}
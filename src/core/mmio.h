@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Handlers for the I/O region, registered by each device at the register's natural width.
+// Accesses of any other width are split or merged across registers here
+namespace MMIO
+{
+
+using ReadFn = uint32_t (*)();
+// mask has every bit set that the access actually wrote, already shifted into place
+using WriteFn = void (*)(uint32_t data, uint32_t mask);
+
+enum CPUs : uint8_t
+{
+	CPU9 = 1,
+	CPU7 = 2,
+	CPU_BOTH = CPU9 | CPU7,
+};
+
+// A null read handler reads as 0, a null write handler ignores the write
+void Register(uint8_t cpus, uint32_t addr, int size, ReadFn read, WriteFn write);
+
+uint32_t Read(bool is_arm9, uint32_t addr, int size);
+void Write(bool is_arm9, uint32_t addr, uint32_t data, int size);
+
+// Combines a partial write with a register's current value
+inline uint32_t Merge(uint32_t old, uint32_t data, uint32_t mask)
+{
+	return (old & ~mask) | (data & mask);
+}
+
+}
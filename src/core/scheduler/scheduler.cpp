@@ -0,0 +1,81 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+struct Event
+{
+	uint64_t time;
+	uint64_t id;
+	Scheduler::Callback callback;
+};
+
+// Min-heap on (time, id), the front is always the next event to fire
+std::vector<Event> events;
+
+uint64_t current_time = 0;
+uint64_t next_id = 0;
+
+bool Later(const Event& a, const Event& b)
+{
+	if (a.time != b.time)
+		return a.time > b.time;
+	return a.id > b.id;
+}
+
+void Scheduler::Reset()
+{
+	events.clear();
+	current_time = 0;
+	next_id = 0;
+}
+
+uint64_t Scheduler::GetCurrentTime()
+{
+	return current_time;
+}
+
+uint64_t Scheduler::GetTimeUntilNextEvent()
+{
+	if (events.empty())
+		return UINT64_MAX;
+	return events.front().time - current_time;
+}
+
+void Scheduler::Schedule(uint64_t delay, Callback callback)
+{
+	events.push_back({current_time + delay, next_id++, callback});
+	std::push_heap(events.begin(), events.end(), Later);
+}
+
+void Scheduler::Cancel(Callback callback)
+{
+	auto it = std::remove_if(events.begin(), events.end(), [callback](const Event& e)
+	{
+		return e.callback == callback;
+	});
+
+	if (it == events.end())
+		return;
+
+	events.erase(it, events.end());
+	std::make_heap(events.begin(), events.end(), Later);
+}
+
+void Scheduler::Advance(uint64_t cycles)
+{
+	uint64_t target = current_time + cycles;
+
+	while (!events.empty() && events.front().time <= target)
+	{
+		std::pop_heap(events.begin(), events.end(), Later);
+		Event e = events.back();
+		events.pop_back();
+
+		// Callbacks schedule relative to the moment they were due, not the end of the slice
+		current_time = e.time;
+		e.callback();
+	}
+
+	current_time = target;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// Timestamps are absolute ARM9 cycles (67.03 MHz). The ARM7 and most devices run at half
+// that rate, so their delays are doubled before being scheduled
+namespace Scheduler
+{
+
+using Callback = void (*)();
+
+void Reset();
+
+uint64_t GetCurrentTime();
+
+// Cycles until the earliest pending event, so the CPUs know how far they may run
+uint64_t GetTimeUntilNextEvent();
+
+// Runs callback `delay` cycles from now. Events at the same timestamp run in the order they were added
+void Schedule(uint64_t delay, Callback callback);
+
+// Removes every pending event with this callback
+void Cancel(Callback callback);
+
+// Moves time forward, running every event that became due
+void Advance(uint64_t cycles);
+
+}
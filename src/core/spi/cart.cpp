@@ -2,7 +2,79 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <src/core/bus.h>
+#include <src/core/dma/dma.h>
+#include <src/core/mmio.h>
+#include <src/core/log.h>
+#include <src/core/scheduler/scheduler.h>
+
+const uint8_t* rom = nullptr;
+size_t rom_size = 0;
+
+// Addresses wrap at the next power of two, like the chip's address lines
+uint32_t rom_mask = 0;
+
+void Cartridge::LoadROM(const std::string& file)
+{
+	int fd = open(file.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0)
+	{
+		LOG_ERROR(Cart, "Couldn't open %s\n", file.c_str());
+		exit(1);
+	}
+
+	if (st.st_size < 0x200)
+	{
+		LOG_ERROR(Cart, "%s is too small to be a cartridge\n", file.c_str());
+		exit(1);
+	}
+
+	void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED)
+	{
+		LOG_ERROR(Cart, "Couldn't map %s\n", file.c_str());
+		exit(1);
+	}
+
+	if (rom)
+		munmap((void*)rom, rom_size);
+
+	rom = (const uint8_t*)ptr;
+	rom_size = st.st_size;
+
+	uint64_t mask = 1;
+	while (mask < rom_size)
+		mask <<= 1;
+	rom_mask = mask - 1;
+}
+
+const uint8_t* Cartridge::GetROM()
+{
+	return rom;
+}
+
+size_t Cartridge::GetROMSize()
+{
+	return rom_size;
+}
+
+uint32_t ReadROM32(uint32_t addr)
+{
+	addr &= rom_mask & ~3;
+	if (!rom || addr + 4 > rom_size)
+		return 0xFFFFFFFF;
+
+	uint32_t data;
+	memcpy(&data, &rom[addr], 4);
+	return data;
+}
 
 uint8_t command_data[8];
 uint32_t romctrl;
@@ -10,7 +82,7 @@ uint32_t data_output;
 
 void Cartridge::SendCommandByte(uint8_t data, int index)
 {
-	printf("Adding command byte 0x%02x to %d\n", data, index);
+	LOG_DEBUG(Cart, "Adding command byte 0x%02x to %d\n", data, index);
 	command_data[index] = data;
 }
 
@@ -22,16 +94,36 @@ enum Command
 	READ_HEADER,
 	GET_CHIP_ID,
 	ENABLE_KEY1,
+	READ_DATA,
 } cmd;
 
 uint32_t data_pos = 0;
-int cycles_left = 8;
+uint32_t data_address = 0;
+
+// The bus moves a byte per CLK. ROMCTRL bit 27 picks 33.51 MHz / 5 or / 8, doubled for ARM9 cycles
+uint64_t ClockCycles()
+{
+	return (romctrl & (1 << 27)) ? 16 : 10;
+}
+
+// Time until the next word is in DATA_OUT. Gap2 dummy CLKs go between every 0x200 bytes
+uint64_t WordDelay(int bytes_done)
+{
+	uint64_t clocks = 4;
+	if (bytes_done && (bytes_done & 0x1FF) == 0)
+		clocks += (romctrl >> 16) & 0x3F;
+	return clocks * ClockCycles();
+}
+
+int block_bytes;
+
+void TransferWord();
 
 void Cartridge::WriteROMCTRL(uint32_t data)
 {
 	bool old_transfer_busy = romctrl & (1 << 31);
 
-	printf("Writing 0x%08x to romctrl\n", data);
+	LOG_DEBUG(Cart, "Writing 0x%08x to romctrl\n", data);
 	romctrl = data;
 
 	uint8_t block_size = (romctrl >> 24) & 0x7;
@@ -62,33 +154,53 @@ void Cartridge::WriteROMCTRL(uint32_t data)
 		case 0x3C:
 			cmd = Command::ENABLE_KEY1;
 			break;
+		case 0xB7:
+			cmd = Command::READ_DATA;
+			data_address = (command_data[1] << 24) | (command_data[2] << 16) | (command_data[3] << 8) | command_data[4];
+			// The secure area can't be read this way, it reads from 0x8000 onwards instead
+			if (data_address < 0x8000)
+				data_address = 0x8000 + (data_address & 0x1FF);
+			data_pos = 0;
+			break;
+		case 0xB8:
+			cmd = Command::GET_CHIP_ID;
+			break;
 		default:
-			printf("Unknown cartridge command 0x%02x%02x%02x%02x%02x%02x%02x%02x\n"
+			LOG_ERROR(Cart, "Unknown cartridge command 0x%02x%02x%02x%02x%02x%02x%02x%02x\n"
 				, command_data[0], command_data[1], command_data[2], command_data[3], 
 				command_data[4], command_data[5], command_data[6], command_data[7]);
 			exit(1);
 		}
+
+		// The 8 command bytes and gap1 come before the first word
+		block_bytes = bytes_left;
+		uint64_t delay = (8 + (romctrl & 0x1FFF)) * ClockCycles();
+		if (bytes_left)
+			delay += WordDelay(0);
+
+		Scheduler::Cancel(TransferWord);
+		Scheduler::Schedule(delay, TransferWord);
 	}
 }
 
 uint32_t Cartridge::ReadROMCTRL()
 {
-	printf("Reading from romctrl 0x%08x\n", romctrl);
+	LOG_DEBUG(Cart, "Reading from romctrl 0x%08x\n", romctrl);
 	return romctrl;
 }
 
-uint8_t Cartridge::ReadDataOut(int index)
-{
-	uint8_t* d = (uint8_t*)&data_output;
-	return d[index];
-}
+void FinishTransfer();
 
+// The block only ends once its last word has been read
 uint32_t Cartridge::ReadDataOut()
 {
 	if (romctrl & (1 << 23))
 	{
 		romctrl &= ~(1 << 23);
-		cycles_left = 8;
+		if (bytes_left > 0)
+			Scheduler::Schedule(WordDelay(block_bytes - bytes_left), TransferWord);
+		else
+			FinishTransfer();
 	}
 	return data_output;
 }
@@ -105,49 +217,87 @@ uint32_t Cartridge::ReadAUXSPICNT()
 	return auxspicnt;
 }
 
-void Cartridge::Run(int cycles)
+void FinishTransfer()
 {
-	bool block_busy = romctrl & (1 << 31);
-	bool word_status = romctrl & (1 << 23);
+	romctrl &= ~(1 << 31);
+	if (auxspicnt & (1 << 14))
+	{
+		LOG_DEBUG(Cart, "Triggering Cart interrupt\n");
+		Bus::TriggerInterrupt7(19);
+	}
+}
 
-	if (block_busy && !word_status)
+void TransferWord()
+{
+	if (bytes_left <= 0)
 	{
-		cycles_left -= cycles;
-		if (cycles_left > 0)
-			return;
-		
-		cycles_left = 8;
-		switch (cmd)
-		{
-		case Command::DUMMY:
-			data_output = 0xFFFFFFFF;
-			break;
-		case Command::READ_HEADER:
-			data_output = 0xFFFFFFFF;
-			data_pos += 4;
-			if (data_pos > 0xFFF)
-				data_pos = 0;
-			romctrl |= (1 << 23);
-			break;
-		case Command::GET_CHIP_ID:
-			data_output = 0x3FC2;
-			romctrl |= (1 << 23);
-			break;
-		case Command::ENABLE_KEY1:
-			break;
-		default:
-			printf("Unknown command %d\n", cmd);
-			exit(1);
-		}
-		bytes_left -= 4;
-		if (bytes_left <= 0)
-		{
-			romctrl &= ~(1 << 31);
-			if (auxspicnt & (1 << 14))
-			{
-				printf("Triggering Cart interrupt\n");
-				Bus::TriggerInterrupt7(19);
-			}
-		}
+		FinishTransfer();
+		return;
+	}
+
+	switch (cmd)
+	{
+	case Command::DUMMY:
+		data_output = 0xFFFFFFFF;
+		break;
+	case Command::READ_HEADER:
+		data_output = ReadROM32(data_pos);
+		data_pos += 4;
+		if (data_pos > 0xFFF)
+			data_pos = 0;
+		romctrl |= (1 << 23);
+		break;
+	case Command::GET_CHIP_ID:
+		data_output = 0x3FC2;
+		romctrl |= (1 << 23);
+		break;
+	case Command::ENABLE_KEY1:
+		break;
+	case Command::READ_DATA:
+		// Reads wrap around inside the 4 KiB block they started in
+		data_output = ReadROM32((data_address & ~0xFFF) | ((data_address + data_pos) & 0xFFF));
+		data_pos += 4;
+		romctrl |= (1 << 23);
+		break;
+	default:
+		LOG_ERROR(Cart, "Unknown command %d\n", cmd);
+		exit(1);
+	}
+	bytes_left -= 4;
+
+	// Words nobody has to read come back to back, the rest wait for ReadDataOut.
+	// Whoever has the slot gets to read it by DMA
+	if (romctrl & (1 << 23))
+	{
+		DMA::Trigger(true, DMA::Timing::Cartridge);
+		DMA::Trigger(false, DMA::Timing::Cartridge);
 	}
+	else if (bytes_left > 0)
+		Scheduler::Schedule(WordDelay(block_bytes - bytes_left), TransferWord);
+	else
+		FinishTransfer();
+}
+
+void Cartridge::RegisterMMIO()
+{
+	MMIO::Register(MMIO::CPU_BOTH, 0x040001A0, 4, []() -> uint32_t { return auxspicnt; },
+		[](uint32_t data, uint32_t mask) { WriteAUXSPICNT(MMIO::Merge(auxspicnt, data, mask)); });
+	MMIO::Register(MMIO::CPU_BOTH, 0x040001A4, 4, []() -> uint32_t { return ReadROMCTRL(); },
+		[](uint32_t data, uint32_t mask) { WriteROMCTRL(MMIO::Merge(romctrl, data, mask)); });
+
+	// The command is sent a byte at a time, whatever width the CPU writes it with
+	MMIO::Register(MMIO::CPU_BOTH, 0x040001A8, 4, nullptr, [](uint32_t data, uint32_t mask)
+	{
+		for (int i = 0; i < 4; i++)
+			if (mask & (0xFF << (i * 8)))
+				SendCommandByte(data >> (i * 8), i);
+	});
+	MMIO::Register(MMIO::CPU_BOTH, 0x040001AC, 4, nullptr, [](uint32_t data, uint32_t mask)
+	{
+		for (int i = 0; i < 4; i++)
+			if (mask & (0xFF << (i * 8)))
+				SendCommandByte(data >> (i * 8), i + 4);
+	});
+
+	MMIO::Register(MMIO::CPU_BOTH, 0x04100010, 4, []() -> uint32_t { return ReadDataOut(); }, nullptr);
 }
@@ -1,19 +1,26 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <string>
 
 namespace Cartridge
 {
 
+// Maps the .nds file read-only. Pages are only read once touched, and every emulator running
+// the same file shares them through the page cache
+void LoadROM(const std::string& file);
+const uint8_t* GetROM();
+size_t GetROMSize();
+
 void SendCommandByte(uint8_t data, int index);
 void WriteROMCTRL(uint32_t data);
 uint32_t ReadROMCTRL();
-uint8_t ReadDataOut(int index);
 uint32_t ReadDataOut();
 
 void WriteAUXSPICNT(uint32_t data);
 uint32_t ReadAUXSPICNT();
 
-void Run(int cycles);
+void RegisterMMIO();
 
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include <src/core/mmio.h>
+#include <src/core/log.h>
 
 enum FIRM_COMMAND
 {
@@ -35,7 +37,7 @@ void Firmware::LoadFirmware(std::string fw_path)
 
 void Firmware::WriteSPICNT(uint32_t data)
 {
-	printf("Writing 0x%04x to SPICNT\n", data);
+	LOG_DEBUG(SPI, "Writing 0x%04x to SPICNT\n", data);
 	spicnt = data;
 	selected_device = (data >> 8) & 0x3;
 }
@@ -53,7 +55,7 @@ uint8_t HandleFirmwareCommands(uint8_t data)
 		}
 		else
 		{
-			printf("Reading SPI from fw address 0x%08x\n", address);
+			LOG_TRACE(SPI, "Reading SPI from fw address 0x%08x\n", address);
 			address++;
 			return fw[(address - 1) & (size - 1)];
 		}
@@ -65,7 +67,7 @@ uint8_t HandleFirmwareCommands(uint8_t data)
 			command_id = FIRM_COMMAND::READ_STREAM;
 			break;
 		default:
-			printf("Unknown command 0x%x\n", data);
+			LOG_ERROR(SPI, "Unknown firmware command 0x%x\n", data);
 			exit(1);
 		}
 		break;
@@ -95,13 +97,13 @@ void Firmware::WriteSPIData(uint32_t data)
 				ResetFirmware();
 			break;
 		default:
-			printf("Write to unknown device %d\n", selected_device);
+			LOG_ERROR(SPI, "Write to unknown device %d\n", selected_device);
 			exit(1);
 		}
 
 		if (spicnt & (1 << 14))
 		{
-			printf("SPI Bus interrupt!\n");
+			LOG_ERROR(SPI, "SPI bus interrupts are not implemented\n");
 			exit(1);
 		}
 	}
@@ -109,6 +111,14 @@ void Firmware::WriteSPIData(uint32_t data)
 
 uint8_t Firmware::ReadSPIData()
 {
-	printf("Reading SPI bus\n");
+	LOG_TRACE(SPI, "Reading SPI bus\n");
 	return output;
 }
+
+void Firmware::RegisterMMIO()
+{
+	MMIO::Register(MMIO::CPU7, 0x040001C0, 2, []() -> uint32_t { return spicnt; },
+		[](uint32_t data, uint32_t mask) { WriteSPICNT(MMIO::Merge(spicnt, data, mask)); });
+	MMIO::Register(MMIO::CPU7, 0x040001C2, 2, []() -> uint32_t { return ReadSPIData(); },
+		[](uint32_t data, uint32_t) { WriteSPIData(data & 0xFF); });
+}
@@ -13,4 +13,6 @@ void WriteSPIData(uint32_t data);
 
 uint8_t ReadSPIData();
 
+void RegisterMMIO();
+
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <src/core/mmio.h>
+#include <src/core/log.h>
 
 // Thanks to PSI-Rockin's CorgiDS code for allowing me to understand RTC
 
@@ -55,7 +57,7 @@ void interpret_input()
 				break;
 			}
 			default:
-				printf("[emu/RTC]: Unknown command %d\n", command);
+				LOG_ERROR(RTC, "Unknown command %d\n", command);
 				exit(1);
 			}
 		}
@@ -131,4 +133,9 @@ void RTC::Write(uint16_t value, bool is_8bit)
 		io_reg = value;
 	else
 		io_reg = (io_reg & 1) | (value & 0xFE);
-}
\ No newline at end of file
+}
+void RTC::RegisterMMIO()
+{
+	MMIO::Register(MMIO::CPU7, 0x04000138, 2, []() -> uint32_t { return io_reg; },
+		[](uint32_t data, uint32_t mask) { Write(data, !(mask & 0xFF00)); });
+}
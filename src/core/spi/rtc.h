@@ -7,4 +7,6 @@ namespace RTC
 
 void Write(uint16_t data, bool is_8bit);
 
+void RegisterMMIO();
+
 }
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "timers.h"
+
+#include <cstring>
+#include <utility>
+#include <src/core/bus.h>
+#include <src/core/mmio.h>
+#include <src/core/scheduler/scheduler.h>
+
+struct Timer
+{
+	uint16_t reload;
+	uint8_t control;
+
+	// The counter as of `start`, which is kept on a tick boundary
+	uint32_t counter;
+	uint64_t start;
+};
+
+// Index 0 is the ARM9, 1 the ARM7
+Timer timers[2][4];
+
+// Both CPUs' timers count at the 33.51 MHz bus clock, two ARM9 cycles per tick
+constexpr uint64_t prescaler_cycles[4] = {2, 2 * 64, 2 * 256, 2 * 1024};
+
+bool IsRunning(const Timer& timer)
+{
+	return timer.control & (1 << 7);
+}
+
+// Cascading timers count overflows of the one before instead, timer 0 has nothing to cascade from
+bool IsCounting(int i, const Timer& timer)
+{
+	return IsRunning(timer) && !(i && (timer.control & (1 << 2)));
+}
+
+uint64_t Period(const Timer& timer)
+{
+	return prescaler_cycles[timer.control & 3];
+}
+
+// Brings counter up to the current time
+void Sync(int i, Timer& timer)
+{
+	if (!IsCounting(i, timer))
+		return;
+
+	uint64_t ticks = (Scheduler::GetCurrentTime() - timer.start) / Period(timer);
+	timer.counter += ticks;
+	timer.start += ticks * Period(timer);
+}
+
+template <int cpu, int i>
+void Overflow();
+
+template <int cpu, int i>
+void ScheduleOverflow()
+{
+	Timer& timer = timers[cpu][i];
+	Scheduler::Cancel(Overflow<cpu, i>);
+
+	if (!IsCounting(i, timer))
+		return;
+
+	uint64_t elapsed = Scheduler::GetCurrentTime() - timer.start;
+	Scheduler::Schedule((0x10000 - timer.counter) * Period(timer) - elapsed, Overflow<cpu, i>);
+}
+
+template <int cpu, int i>
+void Wrap()
+{
+	Timer& timer = timers[cpu][i];
+	timer.counter = timer.reload;
+
+	if (timer.control & (1 << 6))
+	{
+		if (cpu == 0)
+			Bus::TriggerInterrupt9(3 + i);
+		else
+			Bus::TriggerInterrupt7(3 + i);
+	}
+
+	if constexpr (i < 3)
+	{
+		Timer& next = timers[cpu][i + 1];
+		if (IsRunning(next) && (next.control & (1 << 2)) && ++next.counter == 0x10000)
+			Wrap<cpu, i + 1>();
+	}
+}
+
+template <int cpu, int i>
+void Overflow()
+{
+	Sync(i, timers[cpu][i]);
+	Wrap<cpu, i>();
+	ScheduleOverflow<cpu, i>();
+}
+
+template <int cpu, int i>
+void WriteControl(uint8_t data)
+{
+	Timer& timer = timers[cpu][i];
+	bool was_running = IsRunning(timer);
+	uint8_t old_mode = timer.control & 7;
+
+	Sync(i, timer);
+	timer.control = data & 0xC7;
+
+	// Starting or switching the prescaler begins a fresh tick, an IRQ enable change keeps the phase
+	if (!was_running && IsRunning(timer))
+		timer.counter = timer.reload;
+	if (!was_running || old_mode != (timer.control & 7))
+		timer.start = Scheduler::GetCurrentTime();
+
+	ScheduleOverflow<cpu, i>();
+}
+
+template <int cpu, int i>
+void RegisterTimer()
+{
+	MMIO::Register(cpu == 0 ? MMIO::CPU9 : MMIO::CPU7, 0x04000100 + i * 4, 4, []() -> uint32_t
+	{
+		Timer& timer = timers[cpu][i];
+		Sync(i, timer);
+		return (timer.counter & 0xFFFF) | (timer.control << 16);
+	},
+	[](uint32_t data, uint32_t mask)
+	{
+		// Writes to the low half set the reload value, the counter only picks it up on the next start or overflow
+		Timer& timer = timers[cpu][i];
+		timer.reload = MMIO::Merge(timer.reload, data, mask & 0xFFFF);
+		if (mask & 0xFF0000)
+			WriteControl<cpu, i>(data >> 16);
+	});
+}
+
+template <int... i>
+void RegisterTimers(std::integer_sequence<int, i...>)
+{
+	(RegisterTimer<0, i>(), ...);
+	(RegisterTimer<1, i>(), ...);
+}
+
+void Timers::Reset()
+{
+	memset(timers, 0, sizeof(timers));
+}
+
+void Timers::RegisterMMIO()
+{
+	RegisterTimers(std::make_integer_sequence<int, 4>());
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// The four timers of each CPU. Counters aren't ticked, they're worked out from the scheduler's
+// timestamp when read, and each overflow is a single scheduled event
+namespace Timers
+{
+
+void Reset();
+
+void RegisterMMIO();
+
+}
@@ -1,12 +1,25 @@
 #include <src/core/bus.h>
 #include <src/core/arm9/arm9.h>
 #include <src/core/arm7/arm7.h>
+#include <src/core/dma/dma.h>
 #include <src/core/spi/firmware.h>
 #include <src/core/spi/cart.h>
 #include <src/core/gpu/gpu.h>
+#include <src/core/gpu/presenter.h>
+#include <src/core/gpu/renderer.h>
+#include <src/core/cpu/jit_x64.h>
+#include <src/core/scheduler/scheduler.h>
+#include <src/core/timers/timers.h>
+#include <src/core/log.h>
 
+#include <algorithm>
 #include <csignal>
 
+void DumpTrace()
+{
+	Log::DumpRing("trace.log");
+}
+
 void signal(int)
 {
     exit(1);
@@ -14,6 +27,13 @@ void signal(int)
 
 int main(int argc, char** argv)
 {
+	// Keeps log messages in memory and writes them out on exit instead of printing them as they happen
+	if (getenv("NDS_TRACE"))
+	{
+		Log::EnableRing();
+		std::atexit(DumpTrace);
+	}
+
 	#if 1
     if (argc < 4)
     {
@@ -36,27 +56,49 @@ int main(int argc, char** argv)
 	Bus::LoadNDS(argv[1]);
 	#endif
 
+	Scheduler::Reset();
     ARM9::Reset();
 	ARM7::Reset();
+	GPU::Reset();
+	DMA::Reset();
+	Timers::Reset();
+
+	Presenter::Init(getenv("NDS_HEADLESS") ? Presenter::Backend::Headless : Presenter::Backend::SDL);
+	if (const char* dir = getenv("NDS_FRAME_DUMP"))
+		Presenter::SetFrameDumpPath(dir);
+
+	// Drawing on the emulation thread is slower but keeps frame dumps in lockstep for debugging
+	if (!getenv("NDS_SYNC_RENDER"))
+		Renderer::StartThread();
+
+	// The recompiler is opt-in until it has seen more testing
+	if (getenv("NDS_JIT"))
+		JIT::Init();
 
     std::signal(SIGABRT, signal);
     std::signal(SIGINT, signal);
     std::atexit(ARM9::Dump);
     std::atexit(ARM7::Dump);
 
+	// Upper bound on how far the CPUs run ahead of each other when no event is close
+	constexpr uint64_t max_slice = 64;
+	// Keeps a fast-forward within what Run takes, even if nothing is scheduled at all
+	constexpr uint64_t max_idle_slice = 1 << 24;
+
     while (1)
 	{
-		for (int i = 0; i < 2048; i++)
-		{
-			for (int i = 0; i < 8; i++)
-			{
-				ARM9::Clock();
-				ARM9::Clock();
-				ARM7::Clock();
-			}
-			Cartridge::Run(8);
-		}
-		GPU::Draw();
+		uint64_t now = Scheduler::GetCurrentTime();
+		uint64_t slice = std::min(Scheduler::GetTimeUntilNextEvent(), max_idle_slice);
+
+		// While both CPUs wait on something only an event can bring, go straight to that event
+		if (!ARM9::Core::IsIdle() || !ARM7::Core::IsIdle())
+			slice = std::min(slice, max_slice);
+
+		// The ARM7 runs at half the ARM9 clock, rounding is carried over between slices
+		ARM9::Run(slice);
+		ARM7::Run((now + slice) / 2 - now / 2);
+
+		Scheduler::Advance(slice);
 	}
 
     return 0;